@@ -1,4 +1,5 @@
 #include "adc.h"
+#include "log.h"
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -47,7 +48,7 @@ static void SetupConversionReadyCallback(void *ConvertionCallback)
 {
     if (gpioInitialise() < 0)
 	{
-		fprintf(stderr, "pigpio initialisation failed\n");
+		LOG_ERROR("pigpio initialisation failed\n");
 		exit(1);
 	}
 
@@ -59,14 +60,14 @@ void Initialize_ADS1115()
 {
 	// open device on /dev/i2c-1 the default on Raspberry Pi B
 	if ((fd = open("/dev/i2c-1", O_RDWR)) < 0) {
-		printf("Error: Couldn't open device! %d\n", fd);
+		LOG_ERROR("Error: Couldn't open device! %d\n", fd);
 		exit (1);
 	}
 
 	int res, retValue;
 	// connect to ADS1115 as i2c slave
 	if (res = ioctl(fd, I2C_SLAVE, asd_address) < 0) {
-		printf("Error: Couldn't find device on address!\n");
+		LOG_ERROR("Error: Couldn't find device on address!\n");
 		exit (1);
 	}
 
@@ -104,7 +105,7 @@ void Initialize_ADS1115()
 	writeBuf[1] = 0b10000000; // MSB 1
 	writeBuf[2] = 0b00000000; 
 	if (retValue = write(fd, writeBuf, 3) != 3) {
-		printf("Value returned: %d\n", retValue);
+		LOG_ERROR("Value returned: %d\n", retValue);
 		perror("Write to register 1");
 		exit (1);
 	}
@@ -122,7 +123,7 @@ void OnConversionReady(int gpio, int level, uint32_t tick, void *data)
 	
 	if((tick - startTick) > 1000000)
 	{
-		printf("Conversions per second: %d\n", conversionCount);
+		LOG_DEBUG("Conversions per second: %d\n", conversionCount);
 		startTick = tick;
 		conversionCount = 0;
 	}
@@ -0,0 +1,48 @@
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+#include "log.h"
+
+#define ARENA_ALIGNMENT 16
+
+int arena_init(struct arena* arena, size_t capacity)
+{
+	arena->capacity = arena_align(capacity);
+	arena->offset = 0;
+	arena->base = (unsigned char*)calloc(1, arena->capacity);
+	if (arena->base == NULL)
+	{
+		LOG_ERROR("Could not reserve arena of %zu bytes\n", arena->capacity);
+		arena->capacity = 0;
+		return 0;
+	}
+	return 1;
+}
+
+// Returns zeroed memory or NULL when arena was sized too small
+void* arena_alloc(struct arena* arena, size_t size)
+{
+	size_t aligned = arena_align(size);
+	if (arena->base == NULL || aligned > arena->capacity - arena->offset)
+	{
+		LOG_ERROR("Arena exhausted: requested %zu, left %zu\n", aligned, arena->capacity - arena->offset);
+		return NULL;
+	}
+
+	void* block = arena->base + arena->offset;
+	arena->offset += aligned;
+	return block;
+}
+
+size_t arena_align(size_t size)
+{
+	return (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+}
+
+void arena_release(struct arena* arena)
+{
+	free(arena->base);
+	arena->base = NULL;
+	arena->capacity = 0;
+	arena->offset = 0;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stddef.h>
+
+// Linear allocator backed by a single block reserved once.
+// Allocations are never freed individually, the whole block is
+// released together with its owner.
+struct arena
+{
+    unsigned char* base;
+    size_t capacity;
+    size_t offset;
+};
+
+int arena_init(struct arena* arena, size_t capacity);
+void* arena_alloc(struct arena* arena, size_t size);
+size_t arena_align(size_t size);
+void arena_release(struct arena* arena);
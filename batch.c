@@ -0,0 +1,446 @@
+// sched_getaffinity and CPU_COUNT
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "reader.h"
+#include "beat.h"
+#include "hrv.h"
+
+// Large recordings are split so a single file can use every core
+#define CHUNK_BYTES (64L * 1024 * 1024)
+// Signal parsed before chunk start to settle filters and thresholds
+#define WARMUP_SECONDS 10.0f
+#define RECENT_SAMPLES 1024
+#define RECORDING_EXTENSION ".dat"
+
+struct file_entry
+{
+    char* path;
+    size_t size;
+    size_t first_task;
+    size_t num_tasks;
+};
+
+// Contiguous byte range of one recording, results are merged per file in task order
+struct task
+{
+    size_t file;
+    size_t begin;
+    size_t end;
+    size_t num_samples;
+    float rate;
+    struct hrv_summary summary;
+    int failed;
+};
+
+struct batch
+{
+    struct file_entry* files;
+    size_t num_files;
+    size_t files_capacity;
+    struct task* tasks;
+    size_t num_tasks;
+    struct task** order;
+    atomic_size_t next_task;
+    float rate;
+};
+
+static void usage(const char* name);
+static void add_file(struct batch* batch, const char* path);
+static void add_path(struct batch* batch, const char* path);
+static void add_list(struct batch* batch, const char* list_path);
+static void create_tasks(struct batch* batch);
+static void* worker(void* arg);
+static void process_task(struct batch* batch, struct task* task);
+static size_t write_summary(struct batch* batch, FILE* out);
+static long get_num_cpus(void);
+static int compare_task_size(const void* a, const void* b);
+static double now_seconds(void);
+
+int main(int argc, char* argv[])
+{
+    struct batch batch = {0};
+    long num_threads = get_num_cpus();
+    const char* output_path = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "j:o:r:h")) != -1)
+    {
+        switch (opt)
+        {
+            case 'j': num_threads = atol(optarg); break;
+            case 'o': output_path = optarg; break;
+            case 'r': batch.rate = atof(optarg); break;
+            default: usage(argv[0]); return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (optind >= argc)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    if (num_threads < 1)
+        num_threads = 1;
+
+    for (int i = optind; i < argc; i++)
+    {
+        if (argv[i][0] == '@')
+            add_list(&batch, argv[i] + 1);
+        else
+            add_path(&batch, argv[i]);
+    }
+    if (batch.num_files == 0)
+    {
+        fprintf(stderr, "No recordings found\n");
+        return 1;
+    }
+
+    create_tasks(&batch);
+    if ((size_t)num_threads > batch.num_tasks)
+        num_threads = batch.num_tasks;
+
+    double started = now_seconds();
+    pthread_t* threads = (pthread_t*)malloc(num_threads * sizeof(pthread_t));
+    for (long i = 0; i < num_threads; i++)
+        pthread_create(&threads[i], NULL, worker, &batch);
+    for (long i = 0; i < num_threads; i++)
+        pthread_join(threads[i], NULL);
+    double elapsed = now_seconds() - started;
+
+    FILE* out = output_path != NULL ? fopen(output_path, "w") : stdout;
+    if (out == NULL)
+    {
+        fprintf(stderr, "Can't open %s\n", output_path);
+        return 1;
+    }
+    size_t num_failed = write_summary(&batch, out);
+    if (out != stdout && fclose(out) != 0)
+    {
+        fprintf(stderr, "Can't write %s\n", output_path);
+        return 1;
+    }
+
+    size_t total_bytes = 0;
+    for (size_t i = 0; i < batch.num_files; i++)
+        total_bytes += batch.files[i].size;
+    double megabytes = total_bytes / (1024.0 * 1024.0);
+    fprintf(stderr, "Processed %zu files (%.1f MB, %zu chunks) on %ld threads in %.3f s: %.1f files/s, %.1f MB/s\n",
+        batch.num_files, megabytes, batch.num_tasks, num_threads, elapsed,
+        batch.num_files / elapsed, megabytes / elapsed);
+
+    for (size_t i = 0; i < batch.num_files; i++)
+        free(batch.files[i].path);
+    free(batch.files);
+    free(batch.tasks);
+    free(batch.order);
+    free(threads);
+
+    // Scripts running unattended must notice files reported as failed
+    if (num_failed > 0)
+    {
+        fprintf(stderr, "%zu of %zu files failed\n", num_failed, batch.num_files);
+        return 1;
+    }
+    return 0;
+}
+
+static void usage(const char* name)
+{
+    fprintf(stderr,
+        "Usage: %s [-j threads] [-o summary.tsv] [-r rate] <file|directory|@list>...\n"
+        "  -j  worker threads (default: all cores this process may use)\n"
+        "  -o  write per file summary here instead of stdout\n"
+        "  -r  sample rate in SPS (default: taken from time column)\n", name);
+}
+
+// Input collection ///////////////////////////////////////////////////////////////////////////////
+
+static void add_file(struct batch* batch, const char* path)
+{
+    struct stat st;
+    if (stat(path, &st) < 0 || !S_ISREG(st.st_mode))
+    {
+        fprintf(stderr, "Skipping %s\n", path);
+        return;
+    }
+
+    if (batch->num_files == batch->files_capacity)
+    {
+        batch->files_capacity = batch->files_capacity ? batch->files_capacity * 2 : 64;
+        batch->files = (struct file_entry*)realloc(batch->files, batch->files_capacity * sizeof(struct file_entry));
+    }
+
+    struct file_entry* file = &batch->files[batch->num_files++];
+    file->path = strdup(path);
+    file->size = st.st_size;
+    file->first_task = 0;
+    file->num_tasks = 0;
+}
+
+static void add_path(struct batch* batch, const char* path)
+{
+    struct stat st;
+    if (stat(path, &st) == 0 && S_ISDIR(st.st_mode))
+    {
+        DIR* dir = opendir(path);
+        if (dir == NULL)
+        {
+            fprintf(stderr, "Can't open directory %s\n", path);
+            return;
+        }
+
+        struct dirent* entry;
+        size_t extension_length = strlen(RECORDING_EXTENSION);
+        while ((entry = readdir(dir)) != NULL)
+        {
+            size_t length = strlen(entry->d_name);
+            if (length <= extension_length || strcmp(entry->d_name + length - extension_length, RECORDING_EXTENSION) != 0)
+                continue;
+            char* file_path = (char*)malloc(strlen(path) + length + 2);
+            sprintf(file_path, "%s/%s", path, entry->d_name);
+            add_file(batch, file_path);
+            free(file_path);
+        }
+        closedir(dir);
+        return;
+    }
+
+    add_file(batch, path);
+}
+
+// One path per line
+static void add_list(struct batch* batch, const char* list_path)
+{
+    FILE* fp = fopen(list_path, "r");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "Can't open list %s\n", list_path);
+        return;
+    }
+
+    char* line = NULL;
+    size_t len = 0;
+    ssize_t read;
+    while ((read = getline(&line, &len, fp)) != -1)
+    {
+        while (read > 0 && (line[read - 1] == '\n' || line[read - 1] == '\r'))
+            line[--read] = '\0';
+        if (read > 0)
+            add_path(batch, line);
+    }
+    free(line);
+    fclose(fp);
+}
+
+// Scheduling /////////////////////////////////////////////////////////////////////////////////////
+
+static void create_tasks(struct batch* batch)
+{
+    size_t num_tasks = 0;
+    for (size_t i = 0; i < batch->num_files; i++)
+        num_tasks += batch->files[i].size / CHUNK_BYTES + 1;
+
+    batch->tasks = (struct task*)calloc(num_tasks, sizeof(struct task));
+    batch->order = (struct task**)malloc(num_tasks * sizeof(struct task*));
+
+    for (size_t i = 0; i < batch->num_files; i++)
+    {
+        struct file_entry* file = &batch->files[i];
+        file->first_task = batch->num_tasks;
+        for (size_t begin = 0; begin < file->size || begin == 0; begin += CHUNK_BYTES)
+        {
+            struct task* task = &batch->tasks[batch->num_tasks++];
+            task->file = i;
+            task->begin = begin;
+            task->end = begin + CHUNK_BYTES < file->size ? begin + CHUNK_BYTES : file->size;
+            file->num_tasks++;
+        }
+    }
+
+    // Biggest work first keeps all threads busy until the end
+    for (size_t i = 0; i < batch->num_tasks; i++)
+        batch->order[i] = &batch->tasks[i];
+    qsort(batch->order, batch->num_tasks, sizeof(struct task*), compare_task_size);
+    atomic_init(&batch->next_task, 0);
+}
+
+static void* worker(void* arg)
+{
+    struct batch* batch = (struct batch*)arg;
+    for (;;)
+    {
+        size_t next = atomic_fetch_add_explicit(&batch->next_task, 1, memory_order_relaxed);
+        if (next >= batch->num_tasks)
+            break;
+        process_task(batch, batch->order[next]);
+    }
+    return NULL;
+}
+
+// Analysis ///////////////////////////////////////////////////////////////////////////////////////
+
+// Rate is taken from the first two time stamps at or after position
+static float detect_rate(const char* cursor, const char* end)
+{
+    double t0, t1;
+    float voltage;
+    if (!reader_next(&cursor, end, &t0, &voltage) || !reader_next(&cursor, end, &t1, &voltage) || t1 <= t0)
+        return 0;
+    return 1.0f / (t1 - t0);
+}
+
+static void process_task(struct batch* batch, struct task* task)
+{
+    struct file_entry* file = &batch->files[task->file];
+    struct recording recording;
+    hrv_summary_init(&task->summary);
+    if (!recording_open(&recording, file->path))
+    {
+        task->failed = 1;
+        return;
+    }
+
+    const char* data = recording.data;
+    const char* end = data + recording.size;
+    const char* begin = reader_line_start(data, end, data + task->begin);
+    const char* stop = reader_line_start(data, end, data + task->end);
+
+    // Line alignment can leave a later chunk empty, that alone loses nothing
+    if (begin == stop && task->begin > 0)
+    {
+        recording_close(&recording);
+        return;
+    }
+
+    // Time stamps may continue past the chunk, so a one line chunk still has a rate.
+    // A chunk without one fails the whole file rather than leaving a silent gap.
+    task->rate = batch->rate > 0 ? batch->rate : detect_rate(begin, end);
+    if (task->rate <= 0)
+    {
+        fprintf(stderr, "Can't detect sample rate of %s at byte %zu\n", file->path, (size_t)(begin - data));
+        task->failed = 1;
+        recording_close(&recording);
+        return;
+    }
+
+    // Warm up on preceding signal, estimated from the length of the first line
+    const char* cursor = begin;
+    if (task->begin > 0)
+    {
+        const char* second_line = reader_line_start(data, end, begin + 1);
+        size_t warmup_bytes = (size_t)(WARMUP_SECONDS * task->rate) * (second_line - begin);
+        cursor = reader_line_start(data, end, begin - (warmup_bytes < (size_t)(begin - data) ? warmup_bytes : (size_t)(begin - data)));
+    }
+
+    struct beat_detector detector;
+    beat_detector_init(&detector, task->rate);
+
+    // Times of recent samples, beats are reported a few samples late
+    double recent_times[RECENT_SAMPLES];
+    int recent_owned[RECENT_SAMPLES];
+    size_t index = 0;
+    double time;
+    float voltage;
+    size_t beat_index;
+    while (cursor < end)
+    {
+        // Beat whose peak lies before stop may complete only after it
+        if (cursor >= stop && !detector.in_qrs)
+            break;
+        int owned = cursor >= begin && cursor < stop;
+        if (!reader_next(&cursor, end, &time, &voltage))
+            break;
+        recent_times[index % RECENT_SAMPLES] = time;
+        recent_owned[index % RECENT_SAMPLES] = owned;
+        task->num_samples += owned;
+        index++;
+
+        if (!beat_detector_process(&detector, voltage, &beat_index) || index - beat_index > RECENT_SAMPLES)
+            continue;
+        // Beats inside the warm up belong to previous chunk, those past stop to the next one
+        if (recent_owned[beat_index % RECENT_SAMPLES])
+            hrv_summary_add_beat(&task->summary, recent_times[beat_index % RECENT_SAMPLES]);
+    }
+
+    recording_close(&recording);
+}
+
+// Output /////////////////////////////////////////////////////////////////////////////////////////
+
+// Returns number of files written as failed
+static size_t write_summary(struct batch* batch, FILE* out)
+{
+    size_t num_failed = 0;
+    fprintf(out, "file\tsamples\trate\tduration_s\tbeats\theart_rate\tsdnn_ms\trmssd_ms\tpnn50\tbradycardia\ttachycardia\tirregular\tpauses\n");
+    for (size_t i = 0; i < batch->num_files; i++)
+    {
+        struct file_entry* file = &batch->files[i];
+        struct hrv_summary summary;
+        hrv_summary_init(&summary);
+        size_t num_samples = 0;
+        float rate = 0;
+        int failed = 0;
+        for (size_t t = file->first_task; t < file->first_task + file->num_tasks; t++)
+        {
+            struct task* task = &batch->tasks[t];
+            hrv_summary_merge(&summary, &task->summary);
+            num_samples += task->num_samples;
+            failed |= task->failed;
+            if (rate == 0)
+                rate = task->rate;
+        }
+
+        if (failed)
+        {
+            fprintf(out, "%s\tfailed\n", file->path);
+            num_failed++;
+            continue;
+        }
+
+        struct hrv_stats stats;
+        hrv_summary_get_stats(&summary, &stats);
+        fprintf(out, "%s\t%zu\t%.1f\t%.1f\t%zu\t%.1f\t%.1f\t%.1f\t%.1f\t%d\t%d\t%d\t%zu\n",
+            file->path, num_samples, rate, rate > 0 ? num_samples / rate : 0, summary.num_beats,
+            stats.heart_rate, stats.sdnn * 1000, stats.rmssd * 1000, stats.pnn50,
+            (stats.flags & HRV_FLAG_BRADYCARDIA) != 0,
+            (stats.flags & HRV_FLAG_TACHYCARDIA) != 0,
+            (stats.flags & HRV_FLAG_IRREGULAR) != 0,
+            summary.num_pauses);
+    }
+    return num_failed;
+}
+
+// Utility ////////////////////////////////////////////////////////////////////////////////////////
+
+static int compare_task_size(const void* a, const void* b)
+{
+    const struct task* task_a = *(struct task* const*)a;
+    const struct task* task_b = *(struct task* const*)b;
+    size_t size_a = task_a->end - task_a->begin;
+    size_t size_b = task_b->end - task_b->begin;
+    return size_a < size_b ? 1 : size_a > size_b ? -1 : 0;
+}
+
+// Cores this process may run on, honours taskset and cgroup cpusets
+static long get_num_cpus(void)
+{
+    cpu_set_t cpus;
+    if (sched_getaffinity(0, sizeof cpus, &cpus) == 0)
+        return CPU_COUNT(&cpus);
+    return sysconf(_SC_NPROCESSORS_ONLN);
+}
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
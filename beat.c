@@ -0,0 +1,115 @@
+#include <math.h>
+#include <string.h>
+#include "beat.h"
+
+#define BEAT_LOWPASS_CUTOFF_HZ 15.0f
+#define BEAT_HIGHPASS_POLE 0.995f
+#define BEAT_WINDOW_SECONDS 0.15f
+#define BEAT_LEARNING_SECONDS 2.0f
+#define BEAT_REFRACTORY_SECONDS 0.2f
+
+void beat_detector_init(struct beat_detector* detector, float rate)
+{
+	memset(detector, 0, sizeof(*detector));
+	detector->rate = rate;
+
+	float rc = 1.0f / (2.0f * (float)M_PI * BEAT_LOWPASS_CUTOFF_HZ);
+	float dt = 1.0f / rate;
+	detector->lp_alpha = dt / (rc + dt);
+
+	detector->window_size = (size_t)(BEAT_WINDOW_SECONDS * rate);
+	if (detector->window_size < 1)
+		detector->window_size = 1;
+	if (detector->window_size > BEAT_MAX_WINDOW_SAMPLES)
+		detector->window_size = BEAT_MAX_WINDOW_SAMPLES;
+
+	detector->learning_samples = (size_t)(BEAT_LEARNING_SECONDS * rate);
+	detector->refractory_samples = (size_t)(BEAT_REFRACTORY_SECONDS * rate);
+}
+
+static float filter(struct beat_detector* detector, float sample)
+{
+	float hp = sample - detector->hp_prev_in + BEAT_HIGHPASS_POLE * detector->hp_prev_out;
+	detector->hp_prev_in = sample;
+	detector->hp_prev_out = hp;
+
+	detector->lp_prev_out += detector->lp_alpha * (hp - detector->lp_prev_out);
+	return detector->lp_prev_out;
+}
+
+static float integrate(struct beat_detector* detector, float filtered)
+{
+	float* h = detector->history;
+	float derivative = (2.0f * filtered + h[3] - h[1] - 2.0f * h[0]) * (detector->rate / 8.0f);
+	h[0] = h[1];
+	h[1] = h[2];
+	h[2] = h[3];
+	h[3] = filtered;
+
+	float squared = derivative * derivative;
+	detector->window_sum += squared - detector->window[detector->window_pos];
+	detector->window[detector->window_pos] = squared;
+	detector->window_pos = (detector->window_pos + 1) % detector->window_size;
+
+	// Running sum is rebuilt once per pass so rounding error can't accumulate over days
+	if (detector->window_pos == 0)
+	{
+		detector->window_sum = 0;
+		for (size_t i = 0; i < detector->window_size; i++)
+			detector->window_sum += detector->window[i];
+	}
+
+	return detector->window_sum > 0 ? detector->window_sum / detector->window_size : 0;
+}
+
+// Feed next sample, returns 1 and the sample index of the R peak when a beat completes.
+// Reported index lags the true R wave by the constant filter delay which cancels out in RR intervals.
+int beat_detector_process(struct beat_detector* detector, float sample, size_t* beat_index)
+{
+	size_t index = detector->sample_index++;
+	float value = integrate(detector, filter(detector, sample));
+
+	// Initial levels are learned from the first seconds of signal
+	if (index < detector->learning_samples)
+	{
+		if (value > detector->signal_level)
+			detector->signal_level = value;
+		detector->noise_level += (value - detector->noise_level) / (index + 1);
+		detector->threshold = detector->noise_level + 0.25f * (detector->signal_level - detector->noise_level);
+		return 0;
+	}
+
+	if (detector->in_qrs)
+	{
+		if (value > detector->qrs_peak)
+		{
+			detector->qrs_peak = value;
+			detector->qrs_peak_index = index;
+		}
+		if (value > 0.5f * detector->threshold)
+			return 0;
+
+		// Falling edge, peak of the integrated wave marks the beat
+		detector->in_qrs = 0;
+		detector->signal_level = 0.125f * detector->qrs_peak + 0.875f * detector->signal_level;
+		detector->threshold = detector->noise_level + 0.25f * (detector->signal_level - detector->noise_level);
+		detector->last_beat_index = detector->qrs_peak_index;
+		detector->has_beat = 1;
+		*beat_index = detector->qrs_peak_index;
+		return 1;
+	}
+
+	int refractory = detector->has_beat && index - detector->last_beat_index < detector->refractory_samples;
+	if (value > detector->threshold && !refractory)
+	{
+		detector->in_qrs = 1;
+		detector->qrs_peak = value;
+		detector->qrs_peak_index = index;
+		return 0;
+	}
+
+	// Noise level follows the signal outside of QRS complexes with one second time constant
+	detector->noise_level += (value - detector->noise_level) / detector->rate;
+	detector->threshold = detector->noise_level + 0.25f * (detector->signal_level - detector->noise_level);
+	return 0;
+}
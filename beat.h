@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stddef.h>
+
+// Longest moving window integration supported (150 ms at 860 SPS)
+#define BEAT_MAX_WINDOW_SAMPLES 160
+
+// QRS detector for a single channel, derived from Pan-Tompkins:
+// band-pass, derivative, squaring and moving window integration
+// followed by an adaptive threshold. Constant memory and O(1) per sample.
+struct beat_detector
+{
+    float rate;
+    size_t sample_index;
+
+    // Band-pass (DC blocker followed by a one-pole low-pass)
+    float hp_prev_in;
+    float hp_prev_out;
+    float lp_prev_out;
+    float lp_alpha;
+
+    // Five point derivative history
+    float history[4];
+
+    // Moving window integration
+    float window[BEAT_MAX_WINDOW_SAMPLES];
+    size_t window_size;
+    size_t window_pos;
+    double window_sum;
+
+    // Adaptive threshold
+    float signal_level;
+    float noise_level;
+    float threshold;
+    size_t learning_samples;
+    size_t refractory_samples;
+    size_t last_beat_index;
+    int has_beat;
+    int in_qrs;
+    float qrs_peak;
+    size_t qrs_peak_index;
+};
+
+void beat_detector_init(struct beat_detector* detector, float rate);
+int beat_detector_process(struct beat_detector* detector, float sample, size_t* beat_index);
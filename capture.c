@@ -0,0 +1,414 @@
+#define GLFW_INCLUDE_ES2
+#include <GLFW/glfw3.h>
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "capture.h"
+#include "log.h"
+
+#define CAPTURE_BYTES_PER_PIXEL 4
+#define CAPTURE_PATH_MAX 512
+
+static const char* video_status[] = { "none", "written", "skipped", "dropped" };
+
+static void* encode(void* arg);
+
+static double now_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+// UTC time in given strftime format followed by milliseconds and Z, e.g. 20240131_142500.123Z
+static void format_utc(const struct timespec* time, const char* format, char* out, size_t size)
+{
+	struct tm utc;
+	gmtime_r(&time->tv_sec, &utc);
+	size_t length = strftime(out, size, format, &utc);
+	snprintf(out + length, size - length, ".%03ldZ", time->tv_nsec / 1000000);
+}
+
+// Arena space taken by capture_create
+size_t capture_get_arena_size(int width, int height)
+{
+	size_t pixels = (size_t)width * height;
+	return arena_align(sizeof(struct capture))
+		+ CAPTURE_SLOTS * arena_align(pixels * CAPTURE_BYTES_PER_PIXEL)
+		+ arena_align((size_t)width * 3)
+		+ arena_align(pixels * 3);
+}
+
+// Each part of the stream is a new file named after its UTC start time, resolution
+// and part number, e.g. capture_20240131_142500.123Z_800x500_000.rgb with index .csv
+static int open_video(struct capture* capture)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+	char stamp[32];
+	format_utc(&now, "%Y%m%d_%H%M%S", stamp, sizeof stamp);
+	snprintf(capture->session, sizeof capture->session, "capture_%s_%dx%d_%03u", stamp, capture->width, capture->height, capture->part);
+
+	char path[CAPTURE_PATH_MAX];
+	snprintf(path, sizeof path, "%s/%s.rgb", capture->directory, capture->session);
+	// Exclusive create, an existing stream is never appended to or overwritten
+	capture->video = fopen(path, "wbx");
+	if (capture->video == NULL)
+	{
+		LOG_ERROR("Can't create video stream %s: %s\n", path, strerror(errno));
+		return 0;
+	}
+
+	snprintf(path, sizeof path, "%s/%s.csv", capture->directory, capture->session);
+	capture->index = fopen(path, "wx");
+	if (capture->index == NULL || fprintf(capture->index, "stream_frame,render_frame,monotonic_ms,wall_clock,status\n") < 0)
+	{
+		LOG_ERROR("Can't create video index %s: %s\n", path, strerror(errno));
+		if (capture->index != NULL)
+			fclose(capture->index);
+		fclose(capture->video);
+		capture->video = NULL;
+		capture->index = NULL;
+		return 0;
+	}
+
+	capture->part_bytes = 0;
+	capture->part_frames = 0;
+	// Records are formatted later, session may be renamed by then
+	LOG_INFO("Video stream part %u: rawvideo rgb24 %dx%d at %.1f fps\n",
+		capture->part, capture->width, capture->height, 1000.0f / capture->video_interval);
+	return 1;
+}
+
+// Buffered data is only known to be on disk once fclose succeeds
+static int close_video(struct capture* capture)
+{
+	int ok = 1;
+	if (fclose(capture->video) != 0)
+	{
+		LOG_ERROR("Can't finish video stream %s.rgb: %s\n", capture->session, strerror(errno));
+		ok = 0;
+	}
+	if (fclose(capture->index) != 0)
+	{
+		LOG_ERROR("Can't finish video index %s.csv: %s\n", capture->session, strerror(errno));
+		ok = 0;
+	}
+	capture->video = NULL;
+	capture->index = NULL;
+	return ok;
+}
+
+// Nothing more is recorded after a failed write, the render thread stops queueing ticks
+static void stop_video(struct capture* capture)
+{
+	LOG_ERROR("Video stream %s stopped after %lu frames\n", capture->session, capture->part_frames);
+	atomic_store(&capture->video_active, 0);
+	if (capture->video != NULL)
+		close_video(capture);
+}
+
+// All storage comes from arena, which must have capture_get_arena_size bytes left.
+// Region is given in window coordinates, video_fps of 0 disables the video stream.
+struct capture* capture_create(struct arena* arena, int x, int y, int width, int height, const char* directory, float video_fps, float budget_ms)
+{
+	struct capture* capture = (struct capture*)arena_alloc(arena, sizeof(struct capture));
+	if (capture == NULL)
+		return NULL;
+	capture->x = x;
+	capture->y = y;
+	capture->width = width;
+	capture->height = height;
+	capture->directory = directory;
+	capture->video_interval = video_fps > 0 ? 1000.0f / video_fps : 0;
+	capture->budget_ms = budget_ms;
+
+	// Frame storage is reserved once, capturing never allocates
+	size_t frame_bytes = (size_t)width * height * CAPTURE_BYTES_PER_PIXEL;
+	for (size_t i = 0; i < CAPTURE_SLOTS; i++)
+	{
+		capture->pixels[i] = (unsigned char*)arena_alloc(arena, frame_bytes);
+		capture->free_slots[i] = i;
+	}
+	capture->num_free = CAPTURE_SLOTS;
+	capture->row = (unsigned char*)arena_alloc(arena, (size_t)width * 3);
+	// Arena memory is zeroed, ticks before the first readback repeat a black frame
+	capture->video_frame = (unsigned char*)arena_alloc(arena, (size_t)width * height * 3);
+
+	atomic_init(&capture->video_active, capture->video_interval > 0 && open_video(capture));
+	atomic_init(&capture->snapshot_requested, 0);
+	pthread_mutex_init(&capture->lock, NULL);
+	pthread_cond_init(&capture->ready, NULL);
+	pthread_create(&capture->worker, NULL, encode, capture);
+	return capture;
+}
+
+// Safe to call from any thread, next rendered frame is saved
+void capture_request_snapshot(struct capture* capture)
+{
+	atomic_store(&capture->snapshot_requested, 1);
+}
+
+// Called on render thread after drawing and before swapping buffers.
+// Video ticks fall on a fixed grid and every tick is queued, with or without pixels.
+// Readback is skipped rather than waited for when both slots are still being encoded,
+// and after an expensive readback video ticks are skipped until its cost is
+// amortised below budget_ms per frame. Snapshots are exempt from the budget,
+// their cost is still counted and delays video.
+void capture_frame(struct capture* capture)
+{
+	unsigned long number = capture->frame_number++;
+	double started = now_ms();
+
+	unsigned long ticks = 0;
+	if (atomic_load_explicit(&capture->video_active, memory_order_relaxed))
+	{
+		if (capture->next_video_time == 0)
+			capture->next_video_time = started;
+		while (started >= capture->next_video_time)
+		{
+			ticks++;
+			capture->next_video_time += capture->video_interval;
+		}
+	}
+
+	int snapshot = atomic_exchange(&capture->snapshot_requested, 0);
+	int skip = capture->skip_frames > 0;
+	if (skip)
+		capture->skip_frames--;
+	if (!snapshot && ticks == 0)
+		return;
+
+	struct capture_frame frame;
+	frame.slot = CAPTURE_SLOTS;
+	frame.snapshot = snapshot;
+	frame.video = ticks == 0 ? CAPTURE_VIDEO_NONE : skip ? CAPTURE_VIDEO_SKIPPED : CAPTURE_VIDEO_WRITTEN;
+	// Only the latest due tick can be read back, earlier ones were missed while not rendering
+	frame.missed = capture->missed + (ticks > 0 ? ticks - 1 : 0);
+	frame.number = number;
+	frame.timestamp = started;
+	clock_gettime(CLOCK_REALTIME, &frame.wall_clock);
+
+	int readback = snapshot || frame.video == CAPTURE_VIDEO_WRITTEN;
+	pthread_mutex_lock(&capture->lock);
+	int queue_free = capture->queue_size < CAPTURE_QUEUE_SIZE;
+	if (readback && queue_free && capture->num_free > 0)
+		frame.slot = capture->free_slots[--capture->num_free];
+	pthread_mutex_unlock(&capture->lock);
+
+	if (readback && frame.slot == CAPTURE_SLOTS)
+	{
+		capture->dropped++;
+		// Snapshot is retried on next frame
+		if (snapshot)
+			atomic_store(&capture->snapshot_requested, 1);
+		frame.snapshot = 0;
+		if (frame.video == CAPTURE_VIDEO_WRITTEN)
+			frame.video = CAPTURE_VIDEO_DROPPED;
+	}
+
+	// Ticks are carried to the next entry rather than lost when the worker falls behind
+	if (!queue_free || (frame.slot == CAPTURE_SLOTS && frame.video == CAPTURE_VIDEO_NONE))
+	{
+		capture->missed += ticks;
+		return;
+	}
+	capture->missed = 0;
+
+	if (frame.slot != CAPTURE_SLOTS)
+		glReadPixels(capture->x, capture->y, capture->width, capture->height, GL_RGBA, GL_UNSIGNED_BYTE, capture->pixels[frame.slot]);
+
+	pthread_mutex_lock(&capture->lock);
+	capture->queue[(capture->queue_head + capture->queue_size++) % CAPTURE_QUEUE_SIZE] = frame;
+	pthread_cond_signal(&capture->ready);
+	pthread_mutex_unlock(&capture->lock);
+
+	if (frame.slot == CAPTURE_SLOTS)
+		return;
+
+	double elapsed = now_ms() - started;
+	capture->captured++;
+	capture->total_ms += elapsed;
+	if (elapsed > capture->max_ms)
+		capture->max_ms = elapsed;
+	if (elapsed > capture->budget_ms)
+		capture->skip_frames = (unsigned long)ceil(elapsed / capture->budget_ms) - 1;
+}
+
+// Encoder /////////////////////////////////////////////////////////////////////////////////////////
+
+// OpenGL rows start at the bottom, files start at the top
+static void convert_row(struct capture* capture, const unsigned char* pixels, int y, unsigned char* rgb)
+{
+	const unsigned char* source = pixels + (size_t)(capture->height - 1 - y) * capture->width * CAPTURE_BYTES_PER_PIXEL;
+	for (int x = 0; x < capture->width; x++)
+	{
+		rgb[x * 3] = source[x * CAPTURE_BYTES_PER_PIXEL];
+		rgb[x * 3 + 1] = source[x * CAPTURE_BYTES_PER_PIXEL + 1];
+		rgb[x * 3 + 2] = source[x * CAPTURE_BYTES_PER_PIXEL + 2];
+	}
+}
+
+// Named after UTC wall clock and render frame, e.g. snapshot_20240131_142500.123Z_00001234.ppm.
+// A snapshot that can't be written completely is removed and reported.
+static void write_snapshot(struct capture* capture, const struct capture_frame* frame)
+{
+	char stamp[32];
+	format_utc(&frame->wall_clock, "%Y%m%d_%H%M%S", stamp, sizeof stamp);
+	char path[CAPTURE_PATH_MAX];
+	snprintf(path, sizeof path, "%s/snapshot_%s_%08lu.ppm", capture->directory, stamp, frame->number);
+	FILE* out = fopen(path, "wbx");
+	if (out == NULL)
+	{
+		LOG_ERROR("Can't create snapshot %s: %s\n", path, strerror(errno));
+		return;
+	}
+
+	int ok = fprintf(out, "P6\n%d %d\n255\n", capture->width, capture->height) > 0;
+	for (int y = 0; ok && y < capture->height; y++)
+	{
+		convert_row(capture, capture->pixels[frame->slot], y, capture->row);
+		ok = fwrite(capture->row, 3, capture->width, out) == (size_t)capture->width;
+	}
+	if (!ok)
+		LOG_ERROR("Can't write snapshot %s: %s\n", path, strerror(errno));
+	if (fclose(out) != 0 && ok)
+	{
+		LOG_ERROR("Can't finish snapshot %s: %s\n", path, strerror(errno));
+		ok = 0;
+	}
+	if (!ok)
+	{
+		remove(path);
+		return;
+	}
+	LOG_INFO("Snapshot of frame %lu saved\n", frame->number);
+}
+
+// Appends current video_frame to the stream and its line to the index,
+// a new part is started first when this frame would exceed CAPTURE_STREAM_MAX_BYTES
+static int write_tick(struct capture* capture, const struct capture_frame* frame, const char* status)
+{
+	size_t frame_bytes = (size_t)capture->width * capture->height * 3;
+	if (capture->part_bytes > 0 && capture->part_bytes + frame_bytes > CAPTURE_STREAM_MAX_BYTES)
+	{
+		capture->part++;
+		if (!close_video(capture) || !open_video(capture))
+			return 0;
+	}
+
+	if (fwrite(capture->video_frame, 1, frame_bytes, capture->video) != frame_bytes)
+	{
+		LOG_ERROR("Can't write video stream %s.rgb: %s\n", capture->session, strerror(errno));
+		return 0;
+	}
+	capture->part_bytes += frame_bytes;
+
+	char wall_clock[40];
+	format_utc(&frame->wall_clock, "%Y-%m-%dT%H:%M:%S", wall_clock, sizeof wall_clock);
+	if (fprintf(capture->index, "%lu,%lu,%.3f,%s,%s\n", capture->part_frames, frame->number, frame->timestamp, wall_clock, status) < 0)
+	{
+		LOG_ERROR("Can't write video index %s.csv: %s\n", capture->session, strerror(errno));
+		return 0;
+	}
+	capture->part_frames++;
+	capture->stream_frames++;
+	return 1;
+}
+
+// Ticks without pixels repeat the previous stream frame
+static void write_video(struct capture* capture, const struct capture_frame* frame)
+{
+	for (unsigned long i = 0; i < frame->missed; i++)
+	{
+		if (!write_tick(capture, frame, "missed"))
+		{
+			stop_video(capture);
+			return;
+		}
+		capture->repeated++;
+	}
+
+	if (frame->video == CAPTURE_VIDEO_NONE)
+		return;
+	if (frame->video == CAPTURE_VIDEO_WRITTEN)
+	{
+		for (int y = 0; y < capture->height; y++)
+			convert_row(capture, capture->pixels[frame->slot], y, capture->video_frame + (size_t)y * capture->width * 3);
+	}
+	if (!write_tick(capture, frame, video_status[frame->video]))
+	{
+		stop_video(capture);
+		return;
+	}
+	if (frame->video != CAPTURE_VIDEO_WRITTEN)
+		capture->repeated++;
+}
+
+static void* encode(void* arg)
+{
+	struct capture* capture = (struct capture*)arg;
+	pthread_mutex_lock(&capture->lock);
+	for (;;)
+	{
+		while (capture->queue_size == 0 && !capture->stopping)
+			pthread_cond_wait(&capture->ready, &capture->lock);
+		if (capture->queue_size == 0)
+			break;
+
+		struct capture_frame frame = capture->queue[capture->queue_head];
+		capture->queue_head = (capture->queue_head + 1) % CAPTURE_QUEUE_SIZE;
+		capture->queue_size--;
+		pthread_mutex_unlock(&capture->lock);
+
+		if (frame.snapshot)
+			write_snapshot(capture, &frame);
+		if (capture->video != NULL)
+			write_video(capture, &frame);
+
+		pthread_mutex_lock(&capture->lock);
+		if (frame.slot != CAPTURE_SLOTS)
+			capture->free_slots[capture->num_free++] = frame.slot;
+	}
+	pthread_mutex_unlock(&capture->lock);
+	return NULL;
+}
+
+// Queued frames are still written before the worker stops.
+// Memory belongs to the arena passed to capture_create and is released with it.
+void capture_destroy(struct capture* capture)
+{
+	pthread_mutex_lock(&capture->lock);
+	capture->stopping = 1;
+	pthread_cond_signal(&capture->ready);
+	pthread_mutex_unlock(&capture->lock);
+	pthread_join(capture->worker, NULL);
+
+	// Ticks still carried by the render thread keep their place in the stream
+	if (capture->video != NULL && capture->missed > 0)
+	{
+		struct capture_frame frame = { 0 };
+		frame.slot = CAPTURE_SLOTS;
+		frame.video = CAPTURE_VIDEO_NONE;
+		frame.missed = capture->missed;
+		frame.number = capture->frame_number;
+		frame.timestamp = now_ms();
+		clock_gettime(CLOCK_REALTIME, &frame.wall_clock);
+		write_video(capture, &frame);
+	}
+
+	LOG_INFO("Capture: %lu frames, %lu captured, %lu dropped, render thread cost avg %.3f ms max %.3f ms\n",
+		capture->frame_number, capture->captured, capture->dropped,
+		capture->captured > 0 ? capture->total_ms / capture->captured : 0.0, capture->max_ms);
+
+	if (capture->video != NULL)
+	{
+		LOG_INFO("Video: %lu stream frames in %u parts, %lu repeated\n", capture->stream_frames, capture->part + 1, capture->repeated);
+		close_video(capture);
+	}
+	pthread_mutex_destroy(&capture->lock);
+	pthread_cond_destroy(&capture->ready);
+}
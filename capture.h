@@ -0,0 +1,97 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <time.h>
+#include <pthread.h>
+#include "arena.h"
+
+// Frames in flight between render thread and encoder
+#define CAPTURE_SLOTS 2
+// Queued entries, ticks without a readback take no slot
+#define CAPTURE_QUEUE_SIZE 64
+// Stream continues in a new part before a file grows beyond this
+#define CAPTURE_STREAM_MAX_BYTES (1024L * 1024 * 1024)
+
+// What happened to the video tick of a queued entry
+enum capture_video
+{
+    CAPTURE_VIDEO_NONE,
+    CAPTURE_VIDEO_WRITTEN,
+    CAPTURE_VIDEO_SKIPPED,
+    CAPTURE_VIDEO_DROPPED
+};
+
+// slot is CAPTURE_SLOTS when nothing was read back.
+// missed counts earlier ticks the render thread didn't reach in time.
+struct capture_frame
+{
+    size_t slot;
+    int snapshot;
+    int video;
+    unsigned long missed;
+    unsigned long number;
+    double timestamp;
+    struct timespec wall_clock;
+};
+
+// Reads rendered frames back on the render thread and hands them to a worker
+// which writes snapshots (PPM) and a raw RGB video stream with a CSV index.
+// Every video tick becomes exactly one stream frame, ticks without a readback
+// repeat the previous frame, so the stream plays back at the configured rate.
+// A failed write stops the stream or drops the snapshot and is logged as an error.
+struct capture
+{
+    int x;
+    int y;
+    int width;
+    int height;
+    const char* directory;
+    // Stream and index file name of the current part without extension
+    char session[80];
+    unsigned part;
+    FILE* video;
+    FILE* index;
+    size_t part_bytes;
+    unsigned long part_frames;
+    // Cleared by the worker when the stream can't be written anymore
+    atomic_int video_active;
+    float video_interval;
+    double next_video_time;
+    float budget_ms;
+    unsigned long skip_frames;
+    unsigned long missed;
+
+    unsigned char* pixels[CAPTURE_SLOTS];
+    size_t free_slots[CAPTURE_SLOTS];
+    size_t num_free;
+    struct capture_frame queue[CAPTURE_QUEUE_SIZE];
+    size_t queue_head;
+    size_t queue_size;
+    unsigned char* row;
+    unsigned char* video_frame;
+
+    pthread_t worker;
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    int stopping;
+    atomic_int snapshot_requested;
+
+    // Render thread statistics
+    unsigned long frame_number;
+    unsigned long captured;
+    unsigned long dropped;
+    double total_ms;
+    double max_ms;
+
+    // Worker statistics
+    unsigned long stream_frames;
+    unsigned long repeated;
+};
+
+size_t capture_get_arena_size(int width, int height);
+struct capture* capture_create(struct arena* arena, int x, int y, int width, int height, const char* directory, float video_fps, float budget_ms);
+void capture_request_snapshot(struct capture* capture);
+void capture_frame(struct capture* capture);
+void capture_destroy(struct capture* capture);
@@ -0,0 +1,278 @@
+#include <math.h>
+#include <stdlib.h>
+#include "hrv.h"
+#include "log.h"
+
+#define HRV_NN50_SECONDS 0.05f
+#define HRV_MIN_BEATS_FOR_FLAGS 8
+#define HRV_BRADYCARDIA_BPM 60.0f
+#define HRV_TACHYCARDIA_BPM 100.0f
+// RMSSD normalised by mean RR above this is treated as irregular rhythm
+#define HRV_IRREGULAR_RATIO 0.1f
+
+static const float window_seconds[HRV_NUM_WINDOWS] = { 60.0f, 300.0f, 3600.0f };
+
+int hrv_init(struct hrv* hrv)
+{
+	hrv->rr = (float*)calloc(HRV_CAPACITY, sizeof(float));
+	hrv->times = (double*)calloc(HRV_CAPACITY, sizeof(double));
+	if (hrv->rr == NULL || hrv->times == NULL)
+	{
+		LOG_ERROR("Could not allocate RR series\n");
+		hrv_free(hrv);
+		return 0;
+	}
+
+	hrv->head = 0;
+	hrv->now = 0;
+	hrv->last_beat_time = 0;
+	hrv->has_last_beat = 0;
+	hrv->last_pause_time = 0;
+	hrv->has_pause = 0;
+	for (size_t i = 0; i < HRV_NUM_WINDOWS; i++)
+	{
+		struct hrv_window window = {0};
+		window.seconds = window_seconds[i];
+		hrv->windows[i] = window;
+	}
+	return 1;
+}
+
+void hrv_free(struct hrv* hrv)
+{
+	free(hrv->rr);
+	free(hrv->times);
+	hrv->rr = NULL;
+	hrv->times = NULL;
+}
+
+static float get_rr(const struct hrv* hrv, uint64_t index)
+{
+	return hrv->rr[index % HRV_CAPACITY];
+}
+
+static void add_diff(struct hrv_window* window, float diff)
+{
+	window->diff_sq_sum += (double)diff * diff;
+	if (fabsf(diff) > HRV_NN50_SECONDS)
+		window->nn50++;
+}
+
+static void remove_diff(struct hrv_window* window, float diff)
+{
+	window->diff_sq_sum -= (double)diff * diff;
+	if (fabsf(diff) > HRV_NN50_SECONDS)
+		window->nn50--;
+}
+
+static void evict(struct hrv* hrv, struct hrv_window* window)
+{
+	float rr = get_rr(hrv, window->tail);
+	window->sum -= rr;
+	window->sum_sq -= (double)rr * rr;
+	window->tail++;
+
+	// Successive difference between evicted interval and the next one leaves too
+	if (hrv->head - window->tail >= 1)
+		remove_diff(window, get_rr(hrv, window->tail) - rr);
+
+	// Reset accumulated rounding error whenever window drains
+	if (window->tail == hrv->head)
+	{
+		window->sum = 0;
+		window->sum_sq = 0;
+		window->diff_sq_sum = 0;
+		window->nn50 = 0;
+	}
+}
+
+// Interval ending at beat_time
+static void add_rr(struct hrv* hrv, float rr, double beat_time)
+{
+	for (size_t i = 0; i < HRV_NUM_WINDOWS; i++)
+	{
+		struct hrv_window* window = &hrv->windows[i];
+		if (hrv->head - window->tail >= HRV_CAPACITY)
+			evict(hrv, window);
+
+		if (hrv->head > window->tail)
+			add_diff(window, rr - get_rr(hrv, hrv->head - 1));
+		window->sum += rr;
+		window->sum_sq += (double)rr * rr;
+	}
+
+	hrv->rr[hrv->head % HRV_CAPACITY] = rr;
+	hrv->times[hrv->head % HRV_CAPACITY] = beat_time;
+	hrv->head++;
+}
+
+// Beat times in seconds, RR interval is derived from previous beat
+void hrv_add_beat(struct hrv* hrv, double beat_time)
+{
+	if (hrv->has_last_beat)
+	{
+		float rr = (float)(beat_time - hrv->last_beat_time);
+		// Short intervals are artifacts or double detections. Long ones are kept out
+		// of the statistics too, but they are a pause in the rhythm and get flagged.
+		if (rr > HRV_MAX_RR_SECONDS)
+		{
+			hrv->last_pause_time = beat_time;
+			hrv->has_pause = 1;
+		}
+		else if (rr >= HRV_MIN_RR_SECONDS)
+		{
+			add_rr(hrv, rr, beat_time);
+		}
+	}
+	hrv->last_beat_time = beat_time;
+	hrv->has_last_beat = 1;
+	hrv_advance(hrv, beat_time);
+}
+
+// Moves signal time forward, also while no beats are detected, evicting
+// intervals that ended before the start of each window
+void hrv_advance(struct hrv* hrv, double now)
+{
+	if (now > hrv->now)
+		hrv->now = now;
+
+	for (size_t i = 0; i < HRV_NUM_WINDOWS; i++)
+	{
+		struct hrv_window* window = &hrv->windows[i];
+		while (window->tail < hrv->head && hrv->times[window->tail % HRV_CAPACITY] < hrv->now - window->seconds)
+			evict(hrv, window);
+	}
+}
+
+static void fill_stats(struct hrv_stats* stats, size_t n, double sum, double sum_sq, double diff_sq_sum, size_t num_diffs, size_t nn50)
+{
+	struct hrv_stats result = {0};
+	result.num_beats = n;
+
+	if (n > 0)
+	{
+		result.mean_rr = sum / n;
+		result.heart_rate = 60.0f / result.mean_rr;
+	}
+	if (n > 1)
+	{
+		double variance = (sum_sq - sum * sum / n) / (n - 1);
+		result.sdnn = variance > 0 ? sqrt(variance) : 0;
+	}
+	if (num_diffs > 0)
+	{
+		result.rmssd = diff_sq_sum > 0 ? sqrt(diff_sq_sum / num_diffs) : 0;
+		result.pnn50 = 100.0f * nn50 / num_diffs;
+	}
+	if (n >= HRV_MIN_BEATS_FOR_FLAGS)
+	{
+		if (result.heart_rate < HRV_BRADYCARDIA_BPM)
+			result.flags |= HRV_FLAG_BRADYCARDIA;
+		if (result.heart_rate > HRV_TACHYCARDIA_BPM)
+			result.flags |= HRV_FLAG_TACHYCARDIA;
+		if (result.rmssd / result.mean_rr > HRV_IRREGULAR_RATIO)
+			result.flags |= HRV_FLAG_IRREGULAR;
+	}
+
+	*stats = result;
+}
+
+void hrv_get_stats(const struct hrv* hrv, size_t window_index, struct hrv_stats* stats)
+{
+	const struct hrv_window* window = &hrv->windows[window_index];
+	size_t n = hrv->head - window->tail;
+	fill_stats(stats, n, window->sum, window->sum_sq, window->diff_sq_sum, n > 0 ? n - 1 : 0, window->nn50);
+
+	// Raised without the minimum beat count, a pause leaves few beats behind.
+	// A pause still going on counts as soon as it is longer than any accepted interval.
+	int ongoing = hrv->has_last_beat && hrv->now - hrv->last_beat_time > HRV_MAX_RR_SECONDS;
+	int recent = hrv->has_pause && hrv->now - hrv->last_pause_time <= window->seconds;
+	if (ongoing || recent)
+		stats->flags |= HRV_FLAG_PAUSE | HRV_FLAG_BRADYCARDIA;
+}
+
+// Whole recording summary //////////////////////////////////////////////////////////////////////
+
+void hrv_summary_init(struct hrv_summary* summary)
+{
+	struct hrv_summary empty = {0};
+	*summary = empty;
+}
+
+static void summary_add_diff(struct hrv_summary* summary, float diff)
+{
+	summary->diff_sq_sum += (double)diff * diff;
+	summary->num_diffs++;
+	if (fabsf(diff) > HRV_NN50_SECONDS)
+		summary->nn50++;
+}
+
+static void summary_add_rr(struct hrv_summary* summary, float rr)
+{
+	if (rr > HRV_MAX_RR_SECONDS)
+		summary->num_pauses++;
+	if (rr < HRV_MIN_RR_SECONDS || rr > HRV_MAX_RR_SECONDS)
+		return;
+
+	if (summary->num_rr > 0)
+		summary_add_diff(summary, rr - summary->last_rr);
+	else
+		summary->first_rr = rr;
+	summary->last_rr = rr;
+	summary->num_rr++;
+	summary->sum += rr;
+	summary->sum_sq += (double)rr * rr;
+}
+
+void hrv_summary_add_beat(struct hrv_summary* summary, double beat_time)
+{
+	if (summary->num_beats > 0)
+		summary_add_rr(summary, (float)(beat_time - summary->last_beat_time));
+	else
+		summary->first_beat_time = beat_time;
+	summary->last_beat_time = beat_time;
+	summary->num_beats++;
+}
+
+// Appends next part, which must directly follow summary in time
+void hrv_summary_merge(struct hrv_summary* summary, const struct hrv_summary* next)
+{
+	if (next->num_beats == 0)
+		return;
+	if (summary->num_beats == 0)
+	{
+		*summary = *next;
+		return;
+	}
+
+	// Interval spanning the boundary between both parts
+	summary_add_rr(summary, (float)(next->first_beat_time - summary->last_beat_time));
+
+	if (next->num_rr > 0)
+	{
+		if (summary->num_rr > 0)
+			summary_add_diff(summary, next->first_rr - summary->last_rr);
+		else
+			summary->first_rr = next->first_rr;
+		summary->last_rr = next->last_rr;
+		summary->num_rr += next->num_rr;
+		summary->sum += next->sum;
+		summary->sum_sq += next->sum_sq;
+		summary->diff_sq_sum += next->diff_sq_sum;
+		summary->num_diffs += next->num_diffs;
+		summary->nn50 += next->nn50;
+	}
+
+	summary->num_pauses += next->num_pauses;
+	summary->num_beats += next->num_beats;
+	summary->last_beat_time = next->last_beat_time;
+}
+
+void hrv_summary_get_stats(const struct hrv_summary* summary, struct hrv_stats* stats)
+{
+	fill_stats(stats, summary->num_rr, summary->sum, summary->sum_sq, summary->diff_sq_sum, summary->num_diffs, summary->nn50);
+
+	// Same rule as the live windows, a single pause is enough
+	if (summary->num_pauses > 0)
+		stats->flags |= HRV_FLAG_PAUSE | HRV_FLAG_BRADYCARDIA;
+}
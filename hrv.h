@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define HRV_NUM_WINDOWS 3
+// Ring holds the longest window at the highest accepted heart rate
+#define HRV_MAX_WINDOW_SECONDS 3600
+#define HRV_MIN_RR_SECONDS 0.2f
+#define HRV_MAX_RR_SECONDS 3.0f
+#define HRV_CAPACITY ((size_t)(HRV_MAX_WINDOW_SECONDS / HRV_MIN_RR_SECONDS))
+
+// Rhythm flags
+#define HRV_FLAG_BRADYCARDIA 0x01
+#define HRV_FLAG_TACHYCARDIA 0x02
+#define HRV_FLAG_IRREGULAR 0x04
+// RR interval above HRV_MAX_RR_SECONDS, always raised together with bradycardia
+#define HRV_FLAG_PAUSE 0x08
+
+// Running sums over RR intervals inside one sliding window.
+// Intervals [tail, head) of the shared ring ended within the last seconds before now.
+struct hrv_window
+{
+    float seconds;
+    uint64_t tail;
+    double sum;
+    double sum_sq;
+    double diff_sq_sum;
+    size_t nn50;
+};
+
+struct hrv_stats
+{
+    size_t num_beats;
+    float heart_rate;
+    float mean_rr;
+    float sdnn;
+    float rmssd;
+    float pnn50;
+    int flags;
+};
+
+// Incremental HRV for a single channel over 1, 5 and 60 minute windows.
+// Each interval is added and evicted once, so updates are O(1) amortized per beat.
+// Windows follow signal time, not beats, so without beats they drain.
+struct hrv
+{
+    float* rr;
+    double* times;
+    uint64_t head;
+    double now;
+    double last_beat_time;
+    int has_last_beat;
+    double last_pause_time;
+    int has_pause;
+    struct hrv_window windows[HRV_NUM_WINDOWS];
+};
+
+// Mergeable totals over a whole recording or a contiguous part of it.
+// Parts processed independently are joined with hrv_summary_merge in time order.
+struct hrv_summary
+{
+    size_t num_beats;
+    double first_beat_time;
+    double last_beat_time;
+    size_t num_rr;
+    float first_rr;
+    float last_rr;
+    double sum;
+    double sum_sq;
+    double diff_sq_sum;
+    size_t num_diffs;
+    size_t nn50;
+    // Intervals above HRV_MAX_RR_SECONDS, kept out of the sums
+    size_t num_pauses;
+};
+
+int hrv_init(struct hrv* hrv);
+void hrv_free(struct hrv* hrv);
+void hrv_add_beat(struct hrv* hrv, double beat_time);
+void hrv_advance(struct hrv* hrv, double now);
+void hrv_get_stats(const struct hrv* hrv, size_t window, struct hrv_stats* stats);
+
+void hrv_summary_init(struct hrv_summary* summary);
+void hrv_summary_add_beat(struct hrv_summary* summary, double beat_time);
+void hrv_summary_merge(struct hrv_summary* summary, const struct hrv_summary* next);
+void hrv_summary_get_stats(const struct hrv_summary* summary, struct hrv_stats* stats);
@@ -0,0 +1,65 @@
+// Sliding windows follow signal time: a long pause and slow beats after it
+// must empty the short window and raise pause and bradycardia flags.
+#include <stdio.h>
+#include "hrv.h"
+
+#define NORMAL_BEATS 300000
+#define NORMAL_RR 0.8
+#define PAUSE_SECONDS 600.0
+#define SLOW_RR 4.0
+#define SLOW_SECONDS 80.0
+
+static int failures = 0;
+
+static void expect(int condition, const char* what)
+{
+    if (!condition)
+    {
+        fprintf(stderr, "FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+int main(void)
+{
+    struct hrv hrv;
+    if (!hrv_init(&hrv))
+        return 1;
+
+    double t = 0;
+    for (int i = 0; i < NORMAL_BEATS; i++, t += NORMAL_RR)
+        hrv_add_beat(&hrv, t);
+    t -= NORMAL_RR;
+
+    struct hrv_stats stats;
+    hrv_get_stats(&hrv, 0, &stats);
+    expect(stats.num_beats >= 70 && stats.num_beats <= 80, "normal rhythm fills 1 minute window");
+    expect(stats.flags == 0, "normal rhythm raises no flag");
+
+    // No beats at all, only time passes
+    hrv_advance(&hrv, t + PAUSE_SECONDS);
+    hrv_get_stats(&hrv, 0, &stats);
+    expect(stats.num_beats == 0, "pause drains 1 minute window");
+    expect((stats.flags & HRV_FLAG_PAUSE) != 0, "ongoing pause is flagged");
+    hrv_get_stats(&hrv, 1, &stats);
+    expect(stats.num_beats == 0, "pause drains 5 minute window");
+
+    t += PAUSE_SECONDS;
+    for (double end = t + SLOW_SECONDS; t < end; t += SLOW_RR)
+        hrv_add_beat(&hrv, t);
+    hrv_get_stats(&hrv, 0, &stats);
+    printf("after pause and %.0f s at %.0f bpm: n=%zu heart rate %.1f flags 0x%x\n",
+        SLOW_SECONDS, 60 / SLOW_RR, stats.num_beats, stats.heart_rate, stats.flags);
+    expect(stats.num_beats < 8, "slow beats leave no normal intervals in 1 minute window");
+    expect((stats.flags & HRV_FLAG_PAUSE) != 0, "slow rhythm is flagged as pause");
+    expect((stats.flags & HRV_FLAG_BRADYCARDIA) != 0, "slow rhythm is flagged as bradycardia");
+
+    // Flags clear once normal rhythm has filled the window again
+    for (double end = t + 120; t < end; t += NORMAL_RR)
+        hrv_add_beat(&hrv, t);
+    hrv_get_stats(&hrv, 0, &stats);
+    expect(stats.flags == 0, "flags clear after recovery");
+
+    hrv_free(&hrv);
+    return failures > 0;
+}
@@ -0,0 +1,278 @@
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "log.h"
+
+// Must be a power of two
+#define LOG_RING_SIZE 4096
+#define LOG_DRAIN_INTERVAL_NS 1000000L
+#define LOG_SPEC_MAX 32
+
+struct log_record
+{
+    atomic_size_t sequence;
+    int level;
+    int num_args;
+    const char* format;
+    int64_t timestamp_ms;
+    union log_arg args[LOG_MAX_ARGS];
+};
+
+// Bounded multi producer, single consumer ring. Each slot carries a sequence
+// number telling producers and the consumer whose turn it is, so neither side locks.
+struct log_ring
+{
+    struct log_record records[LOG_RING_SIZE];
+    _Alignas(64) atomic_size_t head;
+    _Alignas(64) size_t tail;
+    atomic_size_t dropped;
+};
+
+atomic_int log_runtime_level = LOG_LEVEL;
+
+static struct log_ring ring;
+// Monotonic milliseconds refreshed by the background thread, so queued records
+// are stamped with a load instead of a clock call. Stale by at most one drain
+// interval or one formatted record.
+static _Atomic int64_t cached_clock_ms;
+static atomic_int started;
+static atomic_int stopping;
+static pthread_t drain_thread;
+
+static const char* level_names[] = { "ERROR", "WARN", "INFO", "DEBUG", "TRACE" };
+
+static int64_t clock_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void format_record(FILE* out, const struct log_record* record);
+static void* drain(void* arg);
+
+void log_init(void)
+{
+    if (atomic_load(&started))
+        return;
+
+    for (size_t i = 0; i < LOG_RING_SIZE; i++)
+        atomic_init(&ring.records[i].sequence, i);
+    atomic_init(&ring.head, 0);
+    atomic_init(&ring.dropped, 0);
+    ring.tail = 0;
+    atomic_store(&stopping, 0);
+    atomic_store(&cached_clock_ms, clock_ms());
+
+    pthread_create(&drain_thread, NULL, drain, NULL);
+    atomic_store_explicit(&started, 1, memory_order_release);
+}
+
+// Stops background thread after everything queued so far is written
+void log_shutdown(void)
+{
+    if (!atomic_load(&started))
+        return;
+
+    atomic_store(&stopping, 1);
+    pthread_join(drain_thread, NULL);
+    atomic_store(&started, 0);
+
+    size_t dropped = atomic_load(&ring.dropped);
+    if (dropped > 0)
+        fprintf(stderr, "Log: %zu records dropped\n", dropped);
+}
+
+void log_set_level(int level)
+{
+    atomic_store_explicit(&log_runtime_level, level, memory_order_relaxed);
+}
+
+size_t log_dropped(void)
+{
+    return atomic_load_explicit(&ring.dropped, memory_order_relaxed);
+}
+
+void log_write(int level, const char* format, int num_args, const union log_arg* args)
+{
+    struct log_record* record;
+
+    // Errors and warnings are usually followed by exit or a crash, so they never wait
+    // in the ring. Without the background thread every record is written synchronously.
+    if (level <= LOG_LEVEL_WARN || !atomic_load_explicit(&started, memory_order_acquire))
+    {
+        struct log_record direct;
+        direct.level = level;
+        direct.format = format;
+        direct.num_args = num_args;
+        direct.timestamp_ms = clock_ms();
+        memcpy(direct.args, args, num_args * sizeof(union log_arg));
+        FILE* out = level <= LOG_LEVEL_WARN ? stderr : stdout;
+        // One record is written by several stdio calls, keep them together
+        flockfile(out);
+        format_record(out, &direct);
+        funlockfile(out);
+        return;
+    }
+
+    size_t position = atomic_load_explicit(&ring.head, memory_order_relaxed);
+    for (;;)
+    {
+        record = &ring.records[position & (LOG_RING_SIZE - 1)];
+        size_t sequence = atomic_load_explicit(&record->sequence, memory_order_acquire);
+        intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+        if (difference == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit(&ring.head, &position, position + 1, memory_order_relaxed, memory_order_relaxed))
+                break;
+        }
+        else if (difference < 0)
+        {
+            // Ring is full, hot paths never wait for the writer
+            atomic_fetch_add_explicit(&ring.dropped, 1, memory_order_relaxed);
+            return;
+        }
+        else
+        {
+            position = atomic_load_explicit(&ring.head, memory_order_relaxed);
+        }
+    }
+
+    record->level = level;
+    record->format = format;
+    record->num_args = num_args;
+    record->timestamp_ms = atomic_load_explicit(&cached_clock_ms, memory_order_relaxed);
+    memcpy(record->args, args, num_args * sizeof(union log_arg));
+    atomic_store_explicit(&record->sequence, position + 1, memory_order_release);
+}
+
+// Returns number of records written
+static size_t drain_pending(void)
+{
+    size_t written = 0;
+    for (;;)
+    {
+        struct log_record* record = &ring.records[ring.tail & (LOG_RING_SIZE - 1)];
+        size_t sequence = atomic_load_explicit(&record->sequence, memory_order_acquire);
+        if (sequence != ring.tail + 1)
+            break;
+
+        // Producers keep stamping current time while a long backlog is written
+        atomic_store_explicit(&cached_clock_ms, clock_ms(), memory_order_relaxed);
+        format_record(stdout, record);
+        atomic_store_explicit(&record->sequence, ring.tail + LOG_RING_SIZE, memory_order_release);
+        ring.tail++;
+        written++;
+    }
+    return written;
+}
+
+static void* drain(void* arg)
+{
+    struct timespec interval = { 0, LOG_DRAIN_INTERVAL_NS };
+    while (!atomic_load(&stopping))
+    {
+        atomic_store_explicit(&cached_clock_ms, clock_ms(), memory_order_relaxed);
+        if (drain_pending() == 0)
+        {
+            fflush(stdout);
+            nanosleep(&interval, NULL);
+        }
+    }
+    drain_pending();
+    fflush(stdout);
+    return NULL;
+}
+
+// Formatting /////////////////////////////////////////////////////////////////////////////////////
+
+// Rewrites one conversion so it matches the stored argument width:
+// integer length modifiers become ll, everything else is passed as stored.
+static void format_argument(FILE* out, const char* spec, size_t length, char conversion, union log_arg arg)
+{
+    char buffer[LOG_SPEC_MAX];
+    size_t n = 0;
+    for (size_t i = 0; i < length && n < LOG_SPEC_MAX - 4; i++)
+    {
+        if (strchr("hlLqjzt", spec[i]) == NULL)
+            buffer[n++] = spec[i];
+    }
+
+    switch (conversion)
+    {
+        case 'd': case 'i': case 'u': case 'x': case 'X': case 'o':
+            buffer[n++] = 'l';
+            buffer[n++] = 'l';
+            buffer[n++] = conversion;
+            buffer[n] = '\0';
+            fprintf(out, buffer, arg.i);
+            break;
+        case 'c':
+            buffer[n++] = conversion;
+            buffer[n] = '\0';
+            fprintf(out, buffer, (int)arg.i);
+            break;
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+            buffer[n++] = conversion;
+            buffer[n] = '\0';
+            fprintf(out, buffer, arg.f);
+            break;
+        case 's':
+            buffer[n++] = conversion;
+            buffer[n] = '\0';
+            fprintf(out, buffer, arg.p != NULL ? (const char*)arg.p : "(null)");
+            break;
+        default:
+            buffer[n++] = conversion;
+            buffer[n] = '\0';
+            fprintf(out, buffer, arg.p);
+            break;
+    }
+}
+
+static void format_record(FILE* out, const struct log_record* record)
+{
+    fprintf(out, "[%lld.%03d] %s: ", (long long)(record->timestamp_ms / 1000), (int)(record->timestamp_ms % 1000), level_names[record->level]);
+
+    const char* p = record->format;
+    int next_arg = 0;
+    while (*p != '\0')
+    {
+        if (*p != '%')
+        {
+            const char* literal_end = strchr(p, '%');
+            size_t length = literal_end != NULL ? (size_t)(literal_end - p) : strlen(p);
+            fwrite(p, 1, length, out);
+            p += length;
+            continue;
+        }
+
+        if (p[1] == '%')
+        {
+            fputc('%', out);
+            p += 2;
+            continue;
+        }
+
+        // Flags, width, precision and length up to the conversion character
+        const char* spec = p++;
+        while (*p != '\0' && strchr("-+ #0123456789.hlLqjzt", *p) != NULL)
+            p++;
+        if (*p == '\0' || next_arg >= record->num_args)
+        {
+            fputs(spec, out);
+            break;
+        }
+
+        format_argument(out, spec, p - spec, *p, record->args[next_arg++]);
+        p++;
+    }
+
+    // Messages without trailing newline still end up on their own line
+    size_t format_length = strlen(record->format);
+    if (format_length == 0 || record->format[format_length - 1] != '\n')
+        fputc('\n', out);
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+#define LOG_LEVEL_ERROR 0
+#define LOG_LEVEL_WARN 1
+#define LOG_LEVEL_INFO 2
+#define LOG_LEVEL_DEBUG 3
+#define LOG_LEVEL_TRACE 4
+
+// Records above this level are removed at compile time
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+#define LOG_MAX_ARGS 6
+
+// Arguments are stored raw and only formatted by the background thread.
+// Strings passed for %s must outlive the record (literals, argv, long lived buffers)
+// and other pointers must be cast to void* for %p.
+union log_arg
+{
+    long long i;
+    double f;
+    const void* p;
+};
+
+static inline union log_arg log_from_integer(long long value) { union log_arg arg; arg.i = value; return arg; }
+static inline union log_arg log_from_double(double value) { union log_arg arg; arg.f = value; return arg; }
+static inline union log_arg log_from_pointer(const void* value) { union log_arg arg; arg.p = value; return arg; }
+
+#define LOG_ARG(x) _Generic((x), \
+    float: log_from_double, \
+    double: log_from_double, \
+    char*: log_from_pointer, \
+    const char*: log_from_pointer, \
+    void*: log_from_pointer, \
+    const void*: log_from_pointer, \
+    default: log_from_integer)(x)
+
+#define LOG_PACK_1(f) f, 0, NULL
+#define LOG_PACK_2(f, a) f, 1, (union log_arg[]){ LOG_ARG(a) }
+#define LOG_PACK_3(f, a, b) f, 2, (union log_arg[]){ LOG_ARG(a), LOG_ARG(b) }
+#define LOG_PACK_4(f, a, b, c) f, 3, (union log_arg[]){ LOG_ARG(a), LOG_ARG(b), LOG_ARG(c) }
+#define LOG_PACK_5(f, a, b, c, d) f, 4, (union log_arg[]){ LOG_ARG(a), LOG_ARG(b), LOG_ARG(c), LOG_ARG(d) }
+#define LOG_PACK_6(f, a, b, c, d, e) f, 5, (union log_arg[]){ LOG_ARG(a), LOG_ARG(b), LOG_ARG(c), LOG_ARG(d), LOG_ARG(e) }
+#define LOG_PACK_7(f, a, b, c, d, e, g) f, 6, (union log_arg[]){ LOG_ARG(a), LOG_ARG(b), LOG_ARG(c), LOG_ARG(d), LOG_ARG(e), LOG_ARG(g) }
+#define LOG_SELECT(_1, _2, _3, _4, _5, _6, _7, NAME, ...) NAME
+#define LOG_PACK(...) LOG_SELECT(__VA_ARGS__, LOG_PACK_7, LOG_PACK_6, LOG_PACK_5, LOG_PACK_4, LOG_PACK_3, LOG_PACK_2, LOG_PACK_1, 0)(__VA_ARGS__)
+
+#define LOG_AT(level, ...) do { if ((level) <= atomic_load_explicit(&log_runtime_level, memory_order_relaxed)) log_write((level), LOG_PACK(__VA_ARGS__)); } while (0)
+
+#define LOG_ERROR(...) LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(...) LOG_AT(LOG_LEVEL_WARN, __VA_ARGS__)
+#else
+#define LOG_WARN(...) ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(...) LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define LOG_INFO(...) ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_TRACE
+#define LOG_TRACE(...) LOG_AT(LOG_LEVEL_TRACE, __VA_ARGS__)
+#else
+#define LOG_TRACE(...) ((void)0)
+#endif
+
+extern atomic_int log_runtime_level;
+
+void log_init(void);
+void log_shutdown(void);
+void log_set_level(int level);
+size_t log_dropped(void);
+void log_write(int level, const char* format, int num_args, const union log_arg* args);
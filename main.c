@@ -2,6 +2,11 @@
 #include <GLFW/glfw3.h>
 //~ #include "adc.h"
 #include "plotter.h"
+#include "beat.h"
+#include "hrv.h"
+#include "resample.h"
+#include "log.h"
+#include "capture.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
@@ -12,42 +17,47 @@
 // Defines for scales
 #define TIME_SCALE_MAX_VISIBLE_RANGE_SECONDS 6
 #define VOLTAGE_SCALE_MAX_VISIBLE_RANGE_MILLIVOLTS 5
-#define TICK_SPACE_PIXELS 10;
+#define TICK_SPACE_PIXELS 10
 #define TIME_SCALE_TICK_VALUE_SECONDS 0.04
 #define VOLTAGE_SCALE_TICK_VALUE_MILLIVOLTS 0.1
 #define DELAY 3906250L
-
-typedef enum {
-    DATA_RATE_8 = 8,  // 8 samples per second
-    DATA_RATE_16 = 16,  // 16 samples per second
-    DATA_RATE_32 = 32,  // 32 samples per second
-    DATA_RATE_64 = 64,  // 64 samples per second
-    DATA_RATE_128 = 128,  // 128 samples per second (default)
-    DATA_RATE_250 = 250,  // 250 samples per second
-    DATA_RATE_475 = 475,  // 475 samples per second
-    DATA_RATE_860 = 860  // 860 samples per second
-    // ... add new
-} adc_datarate;
-
-struct context
+#define SIMULATION_DATA_RATE (1000000000L / DELAY)
+// Samples collected before they are resampled onto the pixel grid
+#define RESAMPLE_BLOCK_SAMPLES 8
+// Overlay also follows signal time while no beats are detected
+#define OVERLAY_REFRESH_SAMPLES SIMULATION_DATA_RATE
+
+// Archive of what was shown: snapshots on rhythm events or 'S' key and low rate video
+#define CAPTURE_DIRECTORY "."
+#define CAPTURE_VIDEO_FPS 1.0f
+#define CAPTURE_BUDGET_MS 2.0f
+
+// Per channel analysis state
+struct channel
 {
-    adc_datarate
+    struct beat_detector detector;
+    struct hrv hrv;
+    struct resampler resampler;
+    float block[RESAMPLE_BLOCK_SAMPLES];
+    size_t block_size;
+    float* columns;
 };
 
 static float time_val = 0; 
 static float voltage_val = 0;
+static volatile int reading = 1;
 
 void read_ecg_simulation(void);
 static FILE* open_file(char* path);
 static void close_file(FILE* fp);
 static int read_next(float* time, float* voltage, FILE* fp);
 void *threadFunc(void *arg);
+static void update_overlay(struct plotter* plotter, struct hrv* hrv);
 
 int main(void)
 {
-    // Create context
-    struct context config;
-    set_data_rate(&config, adc_datarate.DATA_RATE_250);
+    // Console output is written by a background thread
+    log_init();
 
 	// Create new plotter
     struct plotter* new_plotter = get_plotter();
@@ -81,25 +91,33 @@ int main(void)
     new_plotter->voltage_tick_value = VOLTAGE_SCALE_TICK_VALUE_MILLIVOLTS;
     new_plotter->max_voltage_range = VOLTAGE_SCALE_MAX_VISIBLE_RANGE_MILLIVOLTS;
 	
+    // Capture memory is reserved together with the rest of the plotter
+    enable_capture(new_plotter, CAPTURE_DIRECTORY, CAPTURE_VIDEO_FPS, CAPTURE_BUDGET_MS);
+
 	// Setup plotter (Create window, compile shaders, generate VBOs)
+	// Trace storage is sized from window width, samples are resampled to one per pixel column
     setup_plotter(new_plotter);
 
     int width_pixel, height_pixel;
-    get_window_size_pixel(new_plotter, width_pixel, height_pixel);
-    size_t size = ((TIME_SCALE_TICK_VALUE_SECONDS\TICK_SPACE_PIXELS) * width_pixel * 1000 * config.adc_datarate);
-    printf("buffer size: %d", size);
+    get_window_size_pixel(new_plotter, &width_pixel, &height_pixel);
+    // Detector, HRV and resampler all run at the rate the simulation file is replayed with
+    LOG_INFO("Data rate: %ld SPS, time base: %.0f pixels per second, %.1f seconds visible\n",
+        SIMULATION_DATA_RATE, get_pixels_per_second(new_plotter), width_pixel / get_pixels_per_second(new_plotter));
     
     // read file with frequency 256HZ in another thread
     pthread_t pth;
-	pthread_create(&pth,NULL,threadFunc,NULL);
+	pthread_create(&pth,NULL,threadFunc,new_plotter);
 
     // Call render function
     on_render(new_plotter);
 
+    // Reader still updates plotter, stop it before resources are gone
+    reading = 0;
+    pthread_join(pth,NULL);
+
 	// Free resources
     free_resources(new_plotter);
-    
-    pthread_join(pth,NULL);
+    log_shutdown();
     
     return 0;
 }
@@ -108,7 +126,7 @@ static FILE* open_file(char* path)
 {
     FILE* fp = fopen(path, "r");
     if (fp == NULL)
-        fprintf( stderr, "Can't open given file", 30);
+        LOG_ERROR("Can't open given file %s\n", path);
     return fp;
 }
 
@@ -119,8 +137,9 @@ static void close_file(FILE* fp)
 
 static int read_next(float* time, float* voltage, FILE* fp)
 {
-    char * line = NULL;
-    size_t len = 0;
+    // Line buffer is grown by getline once and reused for every sample
+    static char * line = NULL;
+    static size_t len = 0;
     ssize_t read;
 
     read = getline(&line, &len, fp);
@@ -141,26 +160,82 @@ static int read_next(float* time, float* voltage, FILE* fp)
         *voltage = atof(y);
     }
 
-    printf("x: %f y: %f\n", *time, *voltage);
+    LOG_TRACE("x: %f y: %f\n", *time, *voltage);
 
     return 1;
 }
 
 void *threadFunc(void *arg)
 {
-	
+	struct plotter* plotter = (struct plotter*)arg;
+	struct channel channel;
+	beat_detector_init(&channel.detector, SIMULATION_DATA_RATE);
+	if (!hrv_init(&channel.hrv))
+		return NULL;
+	resampler_init(&channel.resampler, SIMULATION_DATA_RATE, get_pixels_per_second(plotter));
+	channel.block_size = 0;
+	channel.columns = (float*)malloc(resampler_max_output(&channel.resampler, RESAMPLE_BLOCK_SAMPLES) * sizeof(float));
+
 	struct timespec ts = {0, DELAY };
     FILE* fp = open_file("../ecgsyn.dat");
-    while (read_next(&time_val, &voltage_val, fp)) 
+    size_t beat_index;
+    size_t sample_index = 0;
+    while (reading && read_next(&time_val, &voltage_val, fp)) 
     {
+        sample_index++;
+        if (beat_detector_process(&channel.detector, voltage_val, &beat_index))
+        {
+            hrv_add_beat(&channel.hrv, (double)beat_index / SIMULATION_DATA_RATE);
+            update_overlay(plotter, &channel.hrv);
+        }
+        else if (sample_index % OVERLAY_REFRESH_SAMPLES == 0)
+        {
+            hrv_advance(&channel.hrv, (double)sample_index / SIMULATION_DATA_RATE);
+            update_overlay(plotter, &channel.hrv);
+        }
+
+        channel.block[channel.block_size++] = voltage_val;
+        if (channel.block_size == RESAMPLE_BLOCK_SAMPLES)
+        {
+            size_t num_columns = resampler_process(&channel.resampler, channel.block, channel.block_size, channel.columns);
+            push_trace(plotter, channel.columns, num_columns);
+            channel.block_size = 0;
+        }
         nanosleep (&ts, NULL);
     }
     close_file(fp);
+    hrv_free(&channel.hrv);
+    free(channel.columns);
     
     return NULL;
 }
 
-static void set_data_rate(struct context* config, enum adc_datarate)
+// Rows: heart rate, SDNN ms, RMSSD ms, pNN50 %; columns: 1, 5 and 60 minute windows
+static void update_overlay(struct plotter* plotter, struct hrv* hrv)
 {
-    config->adc_datarate = adc_datarate;
+	static int previous_flags = 0;
+	float values[HRV_NUM_WINDOWS * 4];
+	int alarms[HRV_NUM_WINDOWS * 4];
+	for (size_t w = 0; w < HRV_NUM_WINDOWS; w++)
+	{
+		struct hrv_stats stats;
+		hrv_get_stats(hrv, w, &stats);
+		int valid = stats.num_beats > 1;
+		values[w] = valid ? stats.heart_rate : -1;
+		values[HRV_NUM_WINDOWS + w] = valid ? stats.sdnn * 1000 : -1;
+		values[HRV_NUM_WINDOWS * 2 + w] = valid ? stats.rmssd * 1000 : -1;
+		values[HRV_NUM_WINDOWS * 3 + w] = valid ? stats.pnn50 : -1;
+		alarms[w] = stats.flags & (HRV_FLAG_BRADYCARDIA | HRV_FLAG_TACHYCARDIA | HRV_FLAG_PAUSE);
+		alarms[HRV_NUM_WINDOWS + w] = 0;
+		alarms[HRV_NUM_WINDOWS * 2 + w] = stats.flags & HRV_FLAG_IRREGULAR;
+		alarms[HRV_NUM_WINDOWS * 3 + w] = 0;
+	}
+	set_overlay(plotter, values, alarms, HRV_NUM_WINDOWS * 4);
+
+	// Newly raised rhythm flag in the shortest window is archived as it appears on screen
+	struct hrv_stats latest;
+	hrv_get_stats(hrv, 0, &latest);
+	if ((latest.flags & ~previous_flags) != 0 && plotter->capture != NULL)
+		capture_request_snapshot(plotter->capture);
+	previous_flags = latest.flags;
 }
@@ -3,38 +3,69 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
+#include <pthread.h>
 #include "plotter.h"
+#include "log.h"
+#include "capture.h"
 
 #define UNIFORM "uniform_"
+#define NUM_ATTRIBUTES 2
+#define NUM_BUFFERS 4
+#define MILLIVOLTS_SCALE_NUM_TICKS 50
+#define TRACE_GAP_PIXELS 20
+#define OVERLAY_SEGMENTS_PER_DIGIT 7
+#define OVERLAY_DIGIT_WIDTH_PIXELS 8
+#define OVERLAY_DIGIT_HEIGHT_PIXELS 14
+#define OVERLAY_DIGIT_SPACE_PIXELS 4
+#define OVERLAY_COLUMN_SPACE_PIXELS 16
+#define OVERLAY_ROW_SPACE_PIXELS 8
+#define OVERLAY_MARGIN_PIXELS 10
 
 // Setup plotter ///////////////////////////////////////////////////////////////////////////////////////////////////
 
 struct plotter* get_plotter(void)
 {
 	struct plotter* new_plotter = (struct plotter*)malloc(sizeof(struct plotter));
-	printf("Address allocated for new plotter: %p\n", new_plotter);
-	struct plotter plotter;
+	LOG_INFO("Address allocated for new plotter: %p\n", (void*)new_plotter);
+	struct plotter plotter = {0};
 	*new_plotter = plotter;
 	return new_plotter;
 }
 
 void setup_plotter(struct plotter* plotter)
 {
-	printf("Plotter setup started\n");
+	LOG_INFO("Plotter setup started\n");
+    pthread_mutex_init(&plotter->lock, NULL);
     plotter->window = initalize_glfw_window(plotter);
 
+    // Reserve all plotter memory at once, rendering never allocates afterwards
+    if (!arena_init(&plotter->arena, get_arena_size(plotter, NUM_ATTRIBUTES, NUM_BUFFERS)))
+        exit(EXIT_FAILURE);
+    LOG_INFO("Arena reserved: %zu bytes\n", plotter->arena.capacity);
+
     GLuint vs = create_vertex_shader(plotter);
     GLuint fs = create_fragment_shader(plotter);
 
     plotter->program = create_program(vs, fs);
-    char* attributes[] = { "vertex2d", "v_color" };
-    set_attributes(plotter, 2, attributes);
+    char* attributes[NUM_ATTRIBUTES] = { "vertex2d", "v_color" };
+    set_attributes(plotter, NUM_ATTRIBUTES, attributes);
 
-    GLuint buffers[3];
-    create_buffers(plotter, sizeof(buffers)/sizeof(GLuint), buffers);
+    GLuint buffers[NUM_BUFFERS];
+    create_buffers(plotter, NUM_BUFFERS, buffers);
 
     generate_time_scale(plotter);
     generate_millivolts_scale(plotter);
+    generate_trace(plotter);
+    upload_buffers(plotter);
+
+    if (plotter->capture_directory != NULL)
+    {
+        int height = get_viewport_height(plotter);
+        int offset_bottom = (plotter->window_height - height)/2;
+        plotter->capture = capture_create(&plotter->arena, 0, offset_bottom, plotter->window_width, height,
+            plotter->capture_directory, plotter->capture_video_fps, plotter->capture_budget_ms);
+    }
 }
 
 // GLFW region /////////////////////////////////////////////////////////////////////////////////////////////////
@@ -43,14 +74,17 @@ void setup_plotter(struct plotter* plotter)
 static GLFWwindow* initalize_glfw_window(struct plotter* plotter)
 {
     if (!glfwInit())
-        fprintf(stderr, "Could not initialize GLFW\n");
+    {
+        LOG_ERROR("Could not initialize GLFW\n");
+        exit(EXIT_FAILURE);
+    }
 
     // Get primary monitor configuration
     const GLFWvidmode* mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
     plotter->window_width = mode->width;
     plotter->window_height = mode->height;
 
-    printf("Width: %d Height: %d\n", mode->width, mode->height);
+    LOG_INFO("Width: %d Height: %d\n", mode->width, mode->height);
 
     // Set OpenGL ES 2.0 environment
     glfwWindowHint(GLFW_CLIENT_API, GLFW_OPENGL_ES_API);
@@ -61,17 +95,19 @@ static GLFWwindow* initalize_glfw_window(struct plotter* plotter)
     if (!window)
     {
         glfwTerminate();
-			fprintf(stderr, "Could not create GLFW window\n");
+			LOG_ERROR("Could not create GLFW window\n");
+        exit(EXIT_FAILURE);
     }
     glfwMakeContextCurrent(window);
 
     // Configure view port for ECG graph (5mV high and X seconds width)
-    int voltage_scale_height_pixels = (int)((plotter->max_voltage_range / plotter->voltage_tick_value) * plotter->tick_size);
+    int voltage_scale_height_pixels = get_viewport_height(plotter);
     int offset_bottom = (plotter->window_height - voltage_scale_height_pixels)/2;
     glViewport(0, offset_bottom, mode->width, voltage_scale_height_pixels);
     glScissor(0, offset_bottom, mode->width, voltage_scale_height_pixels);
 
     // Set keyboard callback for input keyboard input handling
+    glfwSetWindowUserPointer(window, plotter);
     glfwSetKeyCallback(window, handle_input);
 
     return window;
@@ -80,9 +116,15 @@ static GLFWwindow* initalize_glfw_window(struct plotter* plotter)
 // Callback for keyboard interactions
 static void handle_input(GLFWwindow* window, int key, int scancode, int action, int mods)
 {
+	struct plotter* plotter = (struct plotter*)glfwGetWindowUserPointer(window);
 	if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
 	{
-		exit(EXIT_SUCCESS);
+		// Leave render loop so pending captures are written out
+		glfwSetWindowShouldClose(window, 1);
+	}
+	if (key == GLFW_KEY_S && action == GLFW_PRESS && plotter->capture != NULL)
+	{
+		capture_request_snapshot(plotter->capture);
 	}
 }
 
@@ -93,6 +135,10 @@ void on_render(struct plotter* plotter)
     {
 		render_func(plotter);
 
+		// Read back what is about to be shown
+		if (plotter->capture != NULL)
+			capture_frame(plotter->capture);
+
 		glfwPollEvents();
         // put the stuff we've been drawing onto the display
         glfwSwapBuffers(plotter->window);
@@ -100,6 +146,15 @@ void on_render(struct plotter* plotter)
 }
 
 
+// Archives the graph area as snapshots and a raw video stream written to directory.
+// Must be called before setup_plotter, which reserves capture memory in the arena.
+void enable_capture(struct plotter* plotter, const char* directory, float video_fps, float budget_ms)
+{
+	plotter->capture_directory = directory;
+	plotter->capture_video_fps = video_fps;
+	plotter->capture_budget_ms = budget_ms;
+}
+
 void get_window_size_pixel(struct plotter* plotter, int* width, int* height)
 {
 	glfwGetFramebufferSize(plotter->window, width, height);
@@ -119,7 +174,7 @@ static GLuint create_program(GLuint vertex_shader, GLuint fragment_shader)
     glLinkProgram(program);
     glGetProgramiv(program, GL_LINK_STATUS, &link_ok);
     if (!link_ok) {
-        fprintf(stderr, "Error during program linking!/n");
+        LOG_ERROR("Error during program linking!/n");
         return 0;
     }
 
@@ -156,7 +211,7 @@ static GLuint create_shader(const char* shader_source, GLenum type)
 	glCompileShader(shader);
 	glGetShaderiv(shader, GL_COMPILE_STATUS, &compile_ok);
 	if (!compile_ok) {
-		fprintf(stderr, "Error in vertex shader\n");
+		LOG_ERROR("Error in vertex shader\n");
 		return 0;
 	}
 
@@ -168,7 +223,7 @@ static GLint get_attribute(GLuint program, const char *name)
 {
 	GLint attribute = glGetAttribLocation(program, name);
 	if(attribute == -1)
-		fprintf(stderr, "Could not bind attribute %s\n", name);
+		LOG_ERROR("Could not bind attribute %s\n", name);
 	return attribute;
 }
 
@@ -176,26 +231,26 @@ static GLint get_uniform(GLuint program, const char *name)
 {
 	GLint uniform = glGetUniformLocation(program, name);
 	if(uniform == -1)
-		fprintf(stderr, "Could not bind uniform %s\n", name);
+		LOG_ERROR("Could not bind uniform %s\n", name);
 	return uniform;
 }
 
 static GLint create_attribute(GLuint program, char* attribute_name)
 {
 	int is_uniform = starts_with(UNIFORM, attribute_name);
-	printf("Creating attribute -> %s of type %s for program -> %d\n", attribute_name, is_uniform == 0 ? "regular" : "uniform", program);
+	LOG_INFO("Creating attribute -> %s of type %s for program -> %d\n", attribute_name, is_uniform == 0 ? "regular" : "uniform", program);
     GLint attribute = is_uniform == 0 ? glGetAttribLocation(program, attribute_name) : glGetUniformLocation(program, attribute_name);
     if (attribute == -1) {
-        fprintf(stderr, "Could not bind attribute %s\n", attribute_name);
+        LOG_ERROR("Could not bind attribute %s\n", attribute_name);
         return 0;
     }
-	printf("Created attribute -> %d\n", attribute);
+	LOG_INFO("Created attribute -> %d\n", attribute);
     return attribute;
 }
 
 static void set_attributes(struct plotter* plotter, size_t num_attributes, char* attributes[])
 {
-	plotter->attributes = (GLint*)calloc(num_attributes, sizeof(GLint));
+	plotter->attributes = (GLint*)arena_alloc(&plotter->arena, num_attributes * sizeof(GLint));
 	for(size_t i = 0; i < num_attributes; i++)
     {
 		*(plotter->attributes + i) = create_attribute(plotter->program, attributes[i]);
@@ -205,7 +260,8 @@ static void set_attributes(struct plotter* plotter, size_t num_attributes, char*
 // Buffers
 static void create_buffers(struct plotter* plotter, size_t num_buffers, GLuint* buffers)
 {
-	plotter->buffers = (struct buffer*)malloc(num_buffers*sizeof(struct buffer));
+	plotter->buffers = (struct buffer*)arena_alloc(&plotter->arena, num_buffers * sizeof(struct buffer));
+	plotter->num_buffers = num_buffers;
 
     glGenBuffers(num_buffers, buffers);
     for(size_t i = 0;i<num_buffers;i++)
@@ -214,32 +270,95 @@ static void create_buffers(struct plotter* plotter, size_t num_buffers, GLuint*
 		plotter->buffers[i].size_bytes = 0;
 		plotter->buffers[i].data = NULL;
 		plotter->buffers[i].num_elements = 0;
-		printf("Buffer[%d]: %p Size: %d\n", i, plotter->buffers[i].address, plotter->buffers[i].size_bytes);
+		plotter->buffers[i].uploaded_elements = 0;
+		plotter->buffers[i].capacity = 0;
+		plotter->buffers[i].dirty = 0;
+		LOG_INFO("Buffer[%zu]: %u Size: %zu\n", i, plotter->buffers[i].address, plotter->buffers[i].size_bytes);
+	}
+
+	// Trace storage is preallocated for one segment per pixel column
+	plotter->buffers[2].capacity = get_trace_capacity(plotter);
+	plotter->buffers[2].data = (struct point*)arena_alloc(&plotter->arena, plotter->buffers[2].capacity * sizeof(struct point));
+
+	plotter->buffers[3].capacity = get_overlay_capacity();
+	plotter->buffers[3].data = (struct point*)arena_alloc(&plotter->arena, plotter->buffers[3].capacity * sizeof(struct point));
+}
+
+// Scales never change, trace storage is reserved on GPU once and then only updated
+static void upload_buffers(struct plotter* plotter)
+{
+	for (size_t i = 0; i < 2; i++)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, plotter->buffers[i].address);
+		glBufferData(GL_ARRAY_BUFFER, plotter->buffers[i].size_bytes, plotter->buffers[i].data, GL_STATIC_DRAW);
+		plotter->buffers[i].uploaded_elements = plotter->buffers[i].num_elements;
+	}
+
+	for (size_t i = 2; i < plotter->num_buffers; i++)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, plotter->buffers[i].address);
+		glBufferData(GL_ARRAY_BUFFER, plotter->buffers[i].capacity * sizeof(struct point), plotter->buffers[i].data, GL_DYNAMIC_DRAW);
+		plotter->buffers[i].uploaded_elements = plotter->buffers[i].num_elements;
 	}
 }
 
 void free_resources(struct plotter* plotter)
 {
+    if (plotter->capture != NULL)
+        capture_destroy(plotter->capture);
     glDeleteProgram(plotter->program);
-    glDeleteBuffers(1, &((struct buffer*)plotter->buffers)->address);
+    for (size_t i = 0; i < plotter->num_buffers; i++)
+        glDeleteBuffers(1, &plotter->buffers[i].address);
     glfwDestroyWindow(plotter->window);
 	glfwTerminate();
+	arena_release(&plotter->arena);
+	pthread_mutex_destroy(&plotter->lock);
 }
 
 // OpenGL Program setup end /////////////////////////////////////////////////////////////////////////////////////////
 
+// Memory section ///////////////////////////////////////////////////////////////////////////////////////////////////
+
+static size_t get_time_scale_num_ticks(struct plotter* plotter)
+{
+	return plotter->window_width/plotter->tick_size + 1;
+}
+
+// Trace is resampled onto pixel columns, so its size depends on window width only
+static size_t get_trace_capacity(struct plotter* plotter)
+{
+	return plotter->window_width * 2;
+}
+
+static size_t get_overlay_capacity(void)
+{
+	return PLOTTER_OVERLAY_MAX_VALUES * PLOTTER_OVERLAY_DIGITS * OVERLAY_SEGMENTS_PER_DIGIT * 2;
+}
+
+static size_t get_arena_size(struct plotter* plotter, size_t num_attributes, size_t num_buffers)
+{
+	return arena_align(num_attributes * sizeof(GLint))
+		+ arena_align(num_buffers * sizeof(struct buffer))
+		+ arena_align(get_time_scale_num_ticks(plotter) * 2 * sizeof(struct point))
+		+ arena_align(MILLIVOLTS_SCALE_NUM_TICKS * 2 * sizeof(struct point))
+		+ arena_align(get_trace_capacity(plotter) * sizeof(struct point))
+		+ arena_align(get_overlay_capacity() * sizeof(struct point))
+		+ (plotter->capture_directory != NULL ? capture_get_arena_size(plotter->window_width, get_viewport_height(plotter)) : 0);
+}
+
+// Memory section end ///////////////////////////////////////////////////////////////////////////////////////////////
+
 // Rendering section ////////////////////////////////////////////////////////////////////////////////////////////
 
 static void generate_time_scale(struct plotter* plotter)
 {
     float pixel_weight_x = 2.0/plotter->window_width;
-    int num_of_ticks = plotter->window_width/plotter->tick_size + 1;
+    int num_of_ticks = get_time_scale_num_ticks(plotter);
     float tick_width_in_opengl_coord = plotter->tick_size * pixel_weight_x;
     plotter->buffers[0].num_elements = num_of_ticks*2;
-
-    struct point ticks[num_of_ticks*2];
-    plotter->buffers[0].size_bytes = sizeof ticks;
-    plotter->buffers[0].data = (struct point*)calloc(num_of_ticks*2,sizeof(struct point));
+    plotter->buffers[0].capacity = num_of_ticks*2;
+    plotter->buffers[0].size_bytes = num_of_ticks*2*sizeof(struct point);
+    plotter->buffers[0].data = (struct point*)arena_alloc(&plotter->arena, plotter->buffers[0].size_bytes);
 
 	for (int i = 0; i < num_of_ticks; i++)
 	{
@@ -261,23 +380,22 @@ static void generate_time_scale(struct plotter* plotter)
 		plotter->buffers[0].data[i * 2 + 1].color[1] = color[1];
 		plotter->buffers[0].data[i * 2 + 1].color[2] = color[2];
 
-		printf("tick[%d].x = %f tick[%d].y = %f\n", i*2, plotter->buffers[0].data[i * 2].vertex2d[0], i*2, plotter->buffers[0].data[i * 2].vertex2d[1]);
-		printf("tick[%d].x = %f tick[%d].y = %f\n", i*2+1, plotter->buffers[0].data[i * 2+1].vertex2d[0], i*2+1, plotter->buffers[0].data[i * 2+1].vertex2d[1]);
+		LOG_TRACE("tick[%d].x = %f tick[%d].y = %f\n", i*2, plotter->buffers[0].data[i * 2].vertex2d[0], i*2, plotter->buffers[0].data[i * 2].vertex2d[1]);
+		LOG_TRACE("tick[%d].x = %f tick[%d].y = %f\n", i*2+1, plotter->buffers[0].data[i * 2+1].vertex2d[0], i*2+1, plotter->buffers[0].data[i * 2+1].vertex2d[1]);
 	}
 
-	printf("Buffer-> data size: %d, data address: %p address: %p\n", sizeof ticks, ticks);
+	LOG_INFO("Buffer-> data size: %zu, data address: %p\n", plotter->buffers[0].size_bytes, (void*)plotter->buffers[0].data);
 }
 
 static void generate_millivolts_scale(struct plotter* plotter)
 {
 	float pixel_weight_y = 2.0/500;  //plotter->window_height;
-    int num_of_ticks = 50;//plotter->window_height/plotter->tick_size+1;
+    int num_of_ticks = MILLIVOLTS_SCALE_NUM_TICKS;//plotter->window_height/plotter->tick_size+1;
     float tick_width_in_opengl_coord = plotter->tick_size * pixel_weight_y;
     plotter->buffers[1].num_elements = num_of_ticks*2;
-
-    struct point ticks[num_of_ticks*2];
-    plotter->buffers[1].size_bytes = sizeof ticks;
-    plotter->buffers[1].data = (struct point*)calloc(num_of_ticks*2,sizeof(struct point));
+    plotter->buffers[1].capacity = num_of_ticks*2;
+    plotter->buffers[1].size_bytes = num_of_ticks*2*sizeof(struct point);
+    plotter->buffers[1].data = (struct point*)arena_alloc(&plotter->arena, plotter->buffers[1].size_bytes);
 
 	for (int i = 0; i < num_of_ticks; i++) {
 		float y = -1 + i * tick_width_in_opengl_coord;
@@ -298,49 +416,90 @@ static void generate_millivolts_scale(struct plotter* plotter)
 		plotter->buffers[1].data[i * 2 + 1].color[1] = color[1];
 		plotter->buffers[1].data[i * 2 + 1].color[2] = color[2];
 
-		printf("tick[%d].x = %f tick[%d].y = %f\n", i*2, plotter->buffers[0].data[i * 2].vertex2d[0], i*2, plotter->buffers[0].data[i * 2].vertex2d[1]);
-		printf("tick[%d].x = %f tick[%d].y = %f\n", i*2+1, plotter->buffers[0].data[i * 2+1].vertex2d[0], i*2+1, plotter->buffers[0].data[i * 2+1].vertex2d[1]);
+		LOG_TRACE("tick[%d].x = %f tick[%d].y = %f\n", i*2, plotter->buffers[1].data[i * 2].vertex2d[0], i*2, plotter->buffers[1].data[i * 2].vertex2d[1]);
+		LOG_TRACE("tick[%d].x = %f tick[%d].y = %f\n", i*2+1, plotter->buffers[1].data[i * 2+1].vertex2d[0], i*2+1, plotter->buffers[1].data[i * 2+1].vertex2d[1]);
 	}
 }
 
-void set_data(struct plotter* plotter, float* data, size_t size)
+// Seven segment digits, bit 0 is segment 'a' going clockwise and 'g' is the middle one
+static const unsigned char digit_segments[10] = { 0x3F, 0x06, 0x5B, 0x4F, 0x66, 0x6D, 0x7D, 0x07, 0x7F, 0x6F };
+static const float segment_lines[OVERLAY_SEGMENTS_PER_DIGIT][4] = {
+	{ 0, 1, 1, 1 }, { 1, 1, 1, 0.5 }, { 1, 0.5, 1, 0 }, { 0, 0, 1, 0 },
+	{ 0, 0, 0, 0.5 }, { 0, 0.5, 0, 1 }, { 0, 0.5, 1, 0.5 }
+};
+#define SEGMENT_DASH 0x40
+
+static size_t add_digit(struct point* points, unsigned char segments, float x, float y, float width, float height, const GLfloat* color)
 {
-	printf("sizeof(data): %d, sizeof(data[0]): %d, data[0]: %f", size * sizeof data[0], sizeof(data[0]), data[0]);
-	size_t num_elements = size/2;
-	plotter->buffers[2].num_elements = num_elements;
-    plotter->buffers[2].size_bytes = num_elements * sizeof(struct point);
-    plotter->buffers[2].data = (struct point*)calloc(num_elements,sizeof(struct point));
-	printf("Buffer[2]: num_elements: %d, size_bytes: %p address: %p\n",plotter->buffers[2].num_elements, plotter->buffers[2].size_bytes,data);
-	for(int i = 0; i < num_elements; i++)
+	size_t num_points = 0;
+	for (int s = 0; s < OVERLAY_SEGMENTS_PER_DIGIT; s++)
 	{
-		plotter->buffers[2].data[i].vertex2d[0] = data[i * 2];
-		plotter->buffers[2].data[i].vertex2d[1] = data[i * 2 + 1];
-		plotter->buffers[2].data[i].color[0] = 0.0;
-		plotter->buffers[2].data[i].color[1] = 0.0;
-		plotter->buffers[2].data[i].color[2] = 0.0;
-		printf("data[%d].x = %f data[%d].y = %f\n", i, plotter->buffers[2].data[i].vertex2d[0], i, plotter->buffers[2].data[i].vertex2d[1]);
+		if (!(segments & (1 << s)))
+			continue;
+		for (int end = 0; end < 2; end++)
+		{
+			struct point* p = &points[num_points++];
+			p->vertex2d[0] = x + segment_lines[s][end * 2] * width;
+			p->vertex2d[1] = y + segment_lines[s][end * 2 + 1] * height;
+			p->color[0] = color[0];
+			p->color[1] = color[1];
+			p->color[2] = color[2];
+		}
 	}
+	return num_points;
 }
 
-static void render_func(struct plotter* plotter)
+// Numeric overlay in the top right corner, values are laid out in rows of PLOTTER_OVERLAY_COLUMNS
+// and drawn as rounded integers. Values flagged in alarms (may be NULL) are drawn in red,
+// negative or NaN values are shown as dashes.
+void set_overlay(struct plotter* plotter, const float* values, const int* alarms, size_t count)
 {
-    int window_width = plotter->window_width;
-	int window_height = plotter->window_height;
-
-	glUseProgram(plotter->program);
-
-	glClearColor(1, 1, 1, 1);
-	glClear(GL_COLOR_BUFFER_BIT);
-
-	// Set the color to black
-	GLfloat black[4] = { 0, 0, 0, 1 };
-	glUniform4fv(plotter->attributes[1], 1, black);
+	if (count > PLOTTER_OVERLAY_MAX_VALUES)
+		count = PLOTTER_OVERLAY_MAX_VALUES;
+
+	float pixel_weight_x = 2.0/plotter->window_width;
+	float pixel_weight_y = 2.0/get_viewport_height(plotter);
+	float digit_width = OVERLAY_DIGIT_WIDTH_PIXELS * pixel_weight_x;
+	float digit_height = OVERLAY_DIGIT_HEIGHT_PIXELS * pixel_weight_y;
+	int digit_step_pixels = OVERLAY_DIGIT_WIDTH_PIXELS + OVERLAY_DIGIT_SPACE_PIXELS;
+	int column_pixels = PLOTTER_OVERLAY_DIGITS * digit_step_pixels + OVERLAY_COLUMN_SPACE_PIXELS;
+	int row_pixels = OVERLAY_DIGIT_HEIGHT_PIXELS + OVERLAY_ROW_SPACE_PIXELS;
+	int left_pixels = plotter->window_width - OVERLAY_MARGIN_PIXELS - PLOTTER_OVERLAY_COLUMNS * column_pixels;
+
+	pthread_mutex_lock(&plotter->lock);
+	struct buffer* overlay = &plotter->buffers[3];
+	size_t num_points = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		GLfloat* color = (GLfloat[3]){0.0, 0.0, 0.0};
+		if (alarms != NULL && alarms[i])
+			color = ((GLfloat[3]){1.0, 0.0, 0.0});
 
-	glEnableVertexAttribArray(plotter->attributes[0]);
-	glEnableVertexAttribArray(plotter->attributes[1]);
+		float x = -1 + (left_pixels + (i % PLOTTER_OVERLAY_COLUMNS) * column_pixels) * pixel_weight_x;
+		float y = 1 - (OVERLAY_MARGIN_PIXELS + (i / PLOTTER_OVERLAY_COLUMNS) * row_pixels) * pixel_weight_y - digit_height;
+
+		int valid = values[i] >= 0 && values[i] < 9999.5f;
+		int number = valid ? (int)lroundf(values[i]) : 0;
+		for (int d = PLOTTER_OVERLAY_DIGITS - 1; d >= 0; d--)
+		{
+			unsigned char segments = valid ? digit_segments[number % 10] : SEGMENT_DASH;
+			float digit_x = x + d * digit_step_pixels * pixel_weight_x;
+			num_points += add_digit(&overlay->data[num_points], segments, digit_x, y, digit_width, digit_height, color);
+			number /= 10;
+			// Right aligned, leading zeros are left blank
+			if (valid && number == 0)
+				break;
+		}
+	}
+	overlay->num_elements = num_points;
+	overlay->size_bytes = num_points * sizeof(struct point);
+	overlay->dirty = 1;
+	pthread_mutex_unlock(&plotter->lock);
+}
 
-	glBindBuffer(GL_ARRAY_BUFFER, plotter->buffers[0].address);
-    glBufferData(GL_ARRAY_BUFFER, plotter->buffers[0].size_bytes, plotter->buffers[0].data, GL_DYNAMIC_DRAW);
+static void draw_buffer(struct plotter* plotter, struct buffer* buffer)
+{
+	glBindBuffer(GL_ARRAY_BUFFER, buffer->address);
 
 	glVertexAttribPointer(
 		plotter->attributes[0],   // attribute
@@ -359,55 +518,110 @@ static void render_func(struct plotter* plotter)
 		(GLvoid*) offsetof(struct point, color)  // offset
 	);
 
-    glDrawArrays(GL_LINES, 0, plotter->buffers[0].num_elements);
+    glDrawArrays(GL_LINES, 0, buffer->uploaded_elements);
+}
 
-	glBindBuffer(GL_ARRAY_BUFFER, plotter->buffers[1].address);
-    glBufferData(GL_ARRAY_BUFFER, plotter->buffers[1].size_bytes, plotter->buffers[1].data, GL_DYNAMIC_DRAW);
+// Each pixel column starts a line segment to the next column. Segments are
+// collapsed to a point until the next column is written, which also hides
+// the gap in front of the sweep.
+static void generate_trace(struct plotter* plotter)
+{
+	struct buffer* trace = &plotter->buffers[2];
+	size_t num_columns = trace->capacity / 2;
+	float pixel_weight_x = 2.0/plotter->window_width;
 
-    glVertexAttribPointer(
-		plotter->attributes[0],   // attribute
-		2,                   // number of elements per vertex, here (x,y)
-		GL_FLOAT,            // the type of each element
-		GL_FALSE,            // take our values as-is
-		sizeof(struct point),  // next coord2d appears every 5 floats
-		0                    // offset of first element
-	);
-	glVertexAttribPointer(
-		plotter->attributes[1],      // attribute
-		3,                      // number of elements per vertex, here (r,g,b)
-		GL_FLOAT,               // the type of each element
-		GL_FALSE,               // take our values as-is
-		sizeof(struct point),  // stride
-		(GLvoid*) offsetof(struct point, color)  // offset
-	);
+	// Nothing is drawn until samples arrive
+	for (size_t column = 0; column < num_columns * 2; column++)
+	{
+		trace->data[column].vertex2d[0] = -1 + (column / 2) * pixel_weight_x;
+		trace->data[column].vertex2d[1] = 0;
+	}
 
-    glDrawArrays(GL_LINES, 0, plotter->buffers[1].num_elements);
+	trace->num_elements = trace->capacity;
+	trace->size_bytes = trace->capacity * sizeof(struct point);
+	plotter->trace_column = 0;
+}
 
-	glBindBuffer(GL_ARRAY_BUFFER, plotter->buffers[2].address);
-    glBufferData(GL_ARRAY_BUFFER, plotter->buffers[2].size_bytes, plotter->buffers[2].data, GL_DYNAMIC_DRAW);
+// Samples must already be on the time base of get_pixels_per_second, one per pixel column
+void push_trace(struct plotter* plotter, const float* millivolts, size_t count)
+{
+	struct buffer* trace = &plotter->buffers[2];
+	size_t num_columns = trace->capacity / 2;
+	float scale = 2.0 / plotter->max_voltage_range;
 
-	glVertexAttribPointer(
-		plotter->attributes[0],   // attribute
-		2,                   // number of elements per vertex, here (x,y)
-		GL_FLOAT,            // the type of each element
-		GL_FALSE,            // take our values as-is
-		sizeof(struct point),  // next coord2d appears every 5 floats
-		0                    // offset of first element
-	);
-	glVertexAttribPointer(
-		plotter->attributes[1],      // attribute
-		3,                      // number of elements per vertex, here (r,g,b)
-		GL_FLOAT,               // the type of each element
-		GL_FALSE,               // take our values as-is
-		sizeof(struct point),  // stride
-		(GLvoid*) offsetof(struct point, color)  // offset
-	);
+	pthread_mutex_lock(&plotter->lock);
+	for (size_t i = 0; i < count; i++)
+	{
+		size_t column = plotter->trace_column;
+		struct point* start = &trace->data[column * 2];
+		float y = millivolts[i] * scale;
+		start[0].vertex2d[1] = y;
+		start[1].vertex2d[0] = start[0].vertex2d[0];
+		start[1].vertex2d[1] = y;
+
+		// Previous segment now reaches this column
+		if (column > 0)
+		{
+			start[-1].vertex2d[0] = start[0].vertex2d[0];
+			start[-1].vertex2d[1] = y;
+		}
+
+		struct point* blank = &trace->data[((column + TRACE_GAP_PIXELS) % num_columns) * 2];
+		blank[1] = blank[0];
+
+		plotter->trace_column = (column + 1) % num_columns;
+	}
+	trace->dirty = 1;
+	pthread_mutex_unlock(&plotter->lock);
+}
 
-    glDrawArrays(GL_LINES, 0, plotter->buffers[2].num_elements);
+// Paper speed of the time scale, e.g. 10 pixel ticks of 40 ms give 25 mm/s at 250 pixels per second
+float get_pixels_per_second(struct plotter* plotter)
+{
+	return plotter->tick_size / plotter->time_tick_value;
+}
+
+static void render_func(struct plotter* plotter)
+{
+	glUseProgram(plotter->program);
+
+	glClearColor(1, 1, 1, 1);
+	glClear(GL_COLOR_BUFFER_BIT);
+
+	// Set the color to black
+	GLfloat black[4] = { 0, 0, 0, 1 };
+	glUniform4fv(plotter->attributes[1], 1, black);
+
+	glEnableVertexAttribArray(plotter->attributes[0]);
+	glEnableVertexAttribArray(plotter->attributes[1]);
+
+	// Trace and overlay are written from other threads, only changed ones are uploaded.
+	// Element count is copied with the data, drawing never reads num_elements unlocked.
+	pthread_mutex_lock(&plotter->lock);
+	for (size_t i = 2; i < plotter->num_buffers; i++)
+	{
+		struct buffer* buffer = &plotter->buffers[i];
+		if (!buffer->dirty)
+			continue;
+		glBindBuffer(GL_ARRAY_BUFFER, buffer->address);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, buffer->size_bytes, buffer->data);
+		buffer->uploaded_elements = buffer->num_elements;
+		buffer->dirty = 0;
+	}
+	pthread_mutex_unlock(&plotter->lock);
+
+	for (size_t i = 0; i < plotter->num_buffers; i++)
+		draw_buffer(plotter, &plotter->buffers[i]);
 }
 
 // Utility functions //////////////////////////////////////////////////////////////////////////////
 
+// Height in pixels of the voltage scale the view port is limited to
+static int get_viewport_height(struct plotter* plotter)
+{
+	return (int)((plotter->max_voltage_range / plotter->voltage_tick_value) * plotter->tick_size);
+}
+
 static int starts_with(const char *pre, const char *str)
 {
     size_t lenpre = strlen(pre),
@@ -1,5 +1,13 @@
 #pragma once
 
+#include <stddef.h>
+#include <pthread.h>
+#include "arena.h"
+
+#define PLOTTER_OVERLAY_COLUMNS 3
+#define PLOTTER_OVERLAY_MAX_VALUES 12
+#define PLOTTER_OVERLAY_DIGITS 4
+
 extern GLFWwindow* window;
 
 struct point {
@@ -20,9 +28,18 @@ struct plotter
     GLFWwindow* window;
     int window_height;
     int window_width;
+    size_t trace_column;
+    size_t num_buffers;
     GLint* attributes;
 	struct buffer* buffers;
     float* data;
+    struct arena arena;
+    pthread_mutex_t lock;
+    struct capture* capture;
+    // Set by enable_capture, capture is created from the arena during setup
+    const char* capture_directory;
+    float capture_video_fps;
+    float capture_budget_ms;
 };
 
 struct buffer
@@ -30,6 +47,10 @@ struct buffer
 	GLuint address;
 	size_t size_bytes;
 	size_t num_elements;
+	// Elements currently in the GL buffer, only touched by the render thread
+	size_t uploaded_elements;
+	size_t capacity;
+	int dirty;
 	struct point* data;
 };
 
@@ -42,6 +63,7 @@ static GLFWwindow* initalize_glfw_window(struct plotter* plotter);
 static void handle_input(GLFWwindow* window, int key, int scancode, int action, int mods);
 void on_render(struct plotter* plotter);
 void get_window_size_pixel(struct plotter* plotter, int* width, int* height);
+void enable_capture(struct plotter* plotter, const char* directory, float video_fps, float budget_ms);
 
 // OpenGL
 static GLuint create_program(GLuint vertex_shader, GLuint fragment_shader);
@@ -55,13 +77,25 @@ static GLint get_uniform(GLuint program, const char *name);
 static GLint create_attribute(GLuint program, char* attribute_name);
 static void set_attributes(struct plotter* plotter, size_t num_attributes, char* attributes[]);
 static void create_buffers(struct plotter* plotter, size_t num_buffers, GLuint* buffers);
+static void upload_buffers(struct plotter* plotter);
 void free_resources(struct plotter* plotter);
 
+// Memory
+static size_t get_time_scale_num_ticks(struct plotter* plotter);
+static size_t get_trace_capacity(struct plotter* plotter);
+static size_t get_overlay_capacity(void);
+static size_t get_arena_size(struct plotter* plotter, size_t num_attributes, size_t num_buffers);
+
 // Render
 static void generate_time_scale(struct plotter* plotter);
 static void generate_millivolts_scale(struct plotter* plotter);
+static void draw_buffer(struct plotter* plotter, struct buffer* buffer);
 static void render_func(struct plotter* plotter);
-void set_data(struct plotter* plotter, float* data, size_t size);
+static void generate_trace(struct plotter* plotter);
+void push_trace(struct plotter* plotter, const float* millivolts, size_t count);
+float get_pixels_per_second(struct plotter* plotter);
+void set_overlay(struct plotter* plotter, const float* values, const int* alarms, size_t count);
 
 // Utility
+static int get_viewport_height(struct plotter* plotter);
 static int starts_with(const char *pre, const char *str);
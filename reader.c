@@ -0,0 +1,145 @@
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "reader.h"
+#include "log.h"
+
+static const double powers_of_ten[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10 };
+
+int recording_open(struct recording* recording, const char* path)
+{
+	recording->data = NULL;
+	recording->size = 0;
+	recording->fd = open(path, O_RDONLY);
+	if (recording->fd < 0)
+	{
+		LOG_ERROR("Can't open %s\n", path);
+		return 0;
+	}
+
+	struct stat st;
+	if (fstat(recording->fd, &st) < 0 || st.st_size == 0)
+	{
+		close(recording->fd);
+		recording->fd = -1;
+		return 0;
+	}
+
+	void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, recording->fd, 0);
+	if (data == MAP_FAILED)
+	{
+		LOG_ERROR("Can't map %s\n", path);
+		close(recording->fd);
+		recording->fd = -1;
+		return 0;
+	}
+
+	// Recording is parsed front to back exactly once
+	madvise(data, st.st_size, MADV_SEQUENTIAL);
+	recording->data = (const char*)data;
+	recording->size = st.st_size;
+	return 1;
+}
+
+void recording_close(struct recording* recording)
+{
+	if (recording->data != NULL)
+		munmap((void*)recording->data, recording->size);
+	if (recording->fd >= 0)
+		close(recording->fd);
+	recording->data = NULL;
+	recording->fd = -1;
+}
+
+// First line starting at or after position, used to split a recording into chunks
+const char* reader_line_start(const char* data, const char* end, const char* position)
+{
+	if (position <= data)
+		return data;
+	if (position >= end)
+		return end;
+	const char* newline = memchr(position - 1, '\n', end - position + 1);
+	return newline == NULL ? end : newline + 1;
+}
+
+static const char* skip_blanks(const char* p, const char* end)
+{
+	while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+		p++;
+	return p;
+}
+
+// Decimal parser without locale or errno handling, good enough for ADC samples and time stamps
+static const char* parse_number(const char* p, const char* end, double* value)
+{
+	int negative = 0;
+	if (p < end && (*p == '-' || *p == '+'))
+		negative = *p++ == '-';
+
+	const char* start = p;
+	double result = 0;
+	while (p < end && *p >= '0' && *p <= '9')
+		result = result * 10 + (*p++ - '0');
+
+	if (p < end && *p == '.')
+	{
+		p++;
+		double scale = 0.1;
+		while (p < end && *p >= '0' && *p <= '9')
+		{
+			result += (*p++ - '0') * scale;
+			scale *= 0.1;
+		}
+	}
+
+	if (p == start)
+		return NULL;
+
+	if (p < end && (*p == 'e' || *p == 'E'))
+	{
+		p++;
+		int exponent_negative = 0;
+		if (p < end && (*p == '-' || *p == '+'))
+			exponent_negative = *p++ == '-';
+		int exponent = 0;
+		while (p < end && *p >= '0' && *p <= '9')
+			exponent = exponent * 10 + (*p++ - '0');
+		if (exponent > 10)
+			exponent = 10;
+		result = exponent_negative ? result / powers_of_ten[exponent] : result * powers_of_ten[exponent];
+	}
+
+	*value = negative ? -result : result;
+	return p;
+}
+
+// Parses next sample and moves cursor past its line, returns 0 at end of data.
+// Malformed lines are skipped.
+int reader_next(const char** cursor, const char* end, double* time, float* voltage)
+{
+	const char* p = *cursor;
+	while (p < end)
+	{
+		const char* line_end = memchr(p, '\n', end - p);
+		if (line_end == NULL)
+			line_end = end;
+
+		double value;
+		const char* q = parse_number(skip_blanks(p, line_end), line_end, time);
+		if (q != NULL)
+			q = parse_number(skip_blanks(q, line_end), line_end, &value);
+
+		p = line_end < end ? line_end + 1 : end;
+		if (q != NULL)
+		{
+			*voltage = (float)value;
+			*cursor = p;
+			return 1;
+		}
+	}
+
+	*cursor = end;
+	return 0;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stddef.h>
+
+// Memory mapped recording in text format, one "time voltage [marker]" sample per line
+struct recording
+{
+    int fd;
+    const char* data;
+    size_t size;
+};
+
+int recording_open(struct recording* recording, const char* path);
+void recording_close(struct recording* recording);
+
+const char* reader_line_start(const char* data, const char* end, const char* position);
+int reader_next(const char** cursor, const char* end, double* time, float* voltage);
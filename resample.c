@@ -0,0 +1,122 @@
+#include <math.h>
+#include <string.h>
+#include "resample.h"
+
+#define RESAMPLE_LANES 4
+
+#if defined(__GNUC__)
+// Portable vector extension, lowered to SSE on x86 and NEON on ARM
+typedef float lanes_f __attribute__((vector_size(RESAMPLE_LANES * sizeof(float))));
+typedef int lanes_i __attribute__((vector_size(RESAMPLE_LANES * sizeof(int))));
+#endif
+
+void resampler_init(struct resampler* resampler, float input_rate, float output_rate)
+{
+	resampler->step = (double)input_rate / output_rate;
+	resampler->position = 0;
+	resampler->previous = 0;
+	resampler->has_previous = 0;
+}
+
+// Upper bound of samples produced by the next call with count input samples
+size_t resampler_max_output(const struct resampler* resampler, size_t count)
+{
+	size_t num_blocks = count / RESAMPLE_MAX_BLOCK + 1;
+	return (size_t)ceil((count + 1) / resampler->step) + num_blocks * RESAMPLE_LANES;
+}
+
+// Positions are counted from scratch[0], the last sample of the previous block,
+// so interpolation runs across block boundaries without keeping more history.
+static size_t process_block(struct resampler* resampler, const float* input, size_t count, float* output)
+{
+	const float* samples = resampler->scratch;
+	resampler->scratch[0] = resampler->previous;
+	memcpy(resampler->scratch + 1, input, count * sizeof(float));
+	resampler->scratch[count + 1] = input[count - 1];
+
+	double position = resampler->position;
+	double step = resampler->step;
+	double last = (double)count;
+	size_t produced = 0;
+
+#if defined(__GNUC__)
+	if (position + (RESAMPLE_LANES - 1) * step < last)
+	{
+		// Lane positions are kept as integer index plus fraction and advanced
+		// by a whole lane group per iteration
+		lanes_i index;
+		lanes_f fraction;
+		for (int lane = 0; lane < RESAMPLE_LANES; lane++)
+		{
+			double lane_position = position + lane * step;
+			index[lane] = (int)lane_position;
+			fraction[lane] = (float)(lane_position - index[lane]);
+		}
+
+		double group_step = RESAMPLE_LANES * step;
+		lanes_i index_step = (lanes_i){0} + (int)group_step;
+		lanes_f fraction_step = (lanes_f){0} + (float)(group_step - (int)group_step);
+		lanes_f one = (lanes_f){0} + 1.0f;
+
+		while (position + (RESAMPLE_LANES - 1) * step < last)
+		{
+			lanes_f a, b;
+			for (int lane = 0; lane < RESAMPLE_LANES; lane++)
+			{
+				a[lane] = samples[index[lane]];
+				b[lane] = samples[index[lane] + 1];
+			}
+
+			lanes_f result = a + fraction * (b - a);
+			memcpy(output + produced, &result, sizeof result);
+			produced += RESAMPLE_LANES;
+			// Same rounding as the scalar remainder, so block boundaries don't depend on lanes
+			for (int lane = 0; lane < RESAMPLE_LANES; lane++)
+				position += step;
+
+			// Carry is -1 in lanes whose fraction wrapped past one
+			fraction += fraction_step;
+			index += index_step;
+			lanes_i carry = fraction >= one;
+			index -= carry;
+			fraction -= (lanes_f)(carry & (lanes_i)one);
+		}
+	}
+#endif
+
+	// Remainder of the block
+	while (position < last)
+	{
+		size_t index = (size_t)position;
+		float fraction = (float)(position - index);
+		float a = samples[index];
+		float b = samples[index + 1];
+		output[produced++] = a + fraction * (b - a);
+		position += step;
+	}
+
+	resampler->position = position - last;
+	resampler->previous = input[count - 1];
+	return produced;
+}
+
+size_t resampler_process(struct resampler* resampler, const float* input, size_t count, float* output)
+{
+	if (count == 0)
+		return 0;
+	if (!resampler->has_previous)
+	{
+		// First sample starts the output time base
+		resampler->previous = input[0];
+		resampler->position = 1;
+		resampler->has_previous = 1;
+	}
+
+	size_t produced = 0;
+	for (size_t offset = 0; offset < count; offset += RESAMPLE_MAX_BLOCK)
+	{
+		size_t block = count - offset < RESAMPLE_MAX_BLOCK ? count - offset : RESAMPLE_MAX_BLOCK;
+		produced += process_block(resampler, input + offset, block, output + produced);
+	}
+	return produced;
+}
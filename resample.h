@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stddef.h>
+
+// Input samples interpolated per pass, longer calls are split
+#define RESAMPLE_MAX_BLOCK 256
+
+// Linear interpolating resampler for one lead. Each lead keeps its own state,
+// so leads recorded at different rates all land on the same output time base.
+struct resampler
+{
+    double step;
+    double position;
+    float previous;
+    int has_previous;
+    // Last sample of previous block followed by current block and one padding sample
+    float scratch[RESAMPLE_MAX_BLOCK + 2];
+};
+
+void resampler_init(struct resampler* resampler, float input_rate, float output_rate);
+size_t resampler_max_output(const struct resampler* resampler, size_t count);
+size_t resampler_process(struct resampler* resampler, const float* input, size_t count, float* output);
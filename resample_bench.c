@@ -0,0 +1,92 @@
+// Per output sample cost of the vector resampler against a scalar kernel
+// over the same contiguous layout. Outputs of both are compared as well.
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "resample.h"
+
+#define BLOCK 256
+#define NUM_CALLS 20000
+#define OUTPUT_RATE 250.0f
+
+struct reference
+{
+    double step;
+    double position;
+    float samples[BLOCK + 2];
+};
+
+// Same interpolation without lanes, state kept like resample.c
+static size_t reference_process(struct reference* reference, const float* input, size_t count, float* output)
+{
+    memmove(reference->samples, reference->samples + count, sizeof(float));
+    memcpy(reference->samples + 1, input, count * sizeof(float));
+    size_t produced = 0;
+    while (reference->position < count)
+    {
+        size_t index = (size_t)reference->position;
+        float fraction = (float)(reference->position - index);
+        float a = reference->samples[index];
+        output[produced++] = a + fraction * (reference->samples[index + 1] - a);
+        reference->position += reference->step;
+    }
+    reference->position -= count;
+    return produced;
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void bench(float rate)
+{
+    static float input[BLOCK];
+    static float vector_output[BLOCK * 32 + 64];
+    static float scalar_output[BLOCK * 32 + 64];
+
+    struct resampler resampler;
+    resampler_init(&resampler, rate, OUTPUT_RATE);
+    struct reference reference = { (double)rate / OUTPUT_RATE, 1, { 0 } };
+
+    double vector_ns = 0, scalar_ns = 0, max_difference = 0;
+    size_t vector_count = 0, scalar_count = 0;
+    for (int call = 0; call < NUM_CALLS; call++)
+    {
+        for (int i = 0; i < BLOCK; i++)
+            input[i] = sinf((call * BLOCK + i) * 0.01f);
+        if (call == 0)
+            reference.samples[BLOCK] = input[0];
+
+        double started = now_ns();
+        size_t produced = resampler_process(&resampler, input, BLOCK, vector_output);
+        vector_ns += now_ns() - started;
+        vector_count += produced;
+
+        started = now_ns();
+        size_t expected = reference_process(&reference, input, BLOCK, scalar_output);
+        scalar_ns += now_ns() - started;
+        scalar_count += expected;
+
+        for (size_t i = 0; i < produced && i < expected; i++)
+        {
+            double difference = fabs(vector_output[i] - scalar_output[i]);
+            if (difference > max_difference)
+                max_difference = difference;
+        }
+    }
+
+    fprintf(stderr, "%4.0f SPS: vector %5.2f ns/sample, scalar %5.2f ns/sample, outputs %zu/%zu, max difference %g\n",
+        rate, vector_ns / vector_count, scalar_ns / scalar_count, vector_count, scalar_count, max_difference);
+}
+
+int main(void)
+{
+    float rates[] = { 8, 128, 256, 475, 860 };
+    for (size_t i = 0; i < sizeof rates / sizeof rates[0]; i++)
+        bench(rates[i]);
+    return 0;
+}